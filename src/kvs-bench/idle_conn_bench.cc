@@ -0,0 +1,128 @@
+// 空闲连接基准：向服务器建立大量连接，每个连接发一条 PING 后保持空闲，
+// 按进度读取服务器进程的 RSS，统计每个空闲连接占用的内存。
+// 目标地址为 127.x 时源地址轮流使用 127.0.0.1 ~ 127.0.0.255，突破单个源地址的临时端口数限制。
+// 客户端和服务器都需要足够的文件描述符上限（ulimit -n）。
+// 用法: ./idle_conn_bench <服务器 pid> [连接数=100000] [ip=127.0.0.1] [端口=2000] [保持秒数=0]
+// 例如: ./idle_conn_bench $(pidof kvstore) 100000
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const size_t kConnsPerSourceAddr = 25000;
+
+static size_t serverRssBytes(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[256];
+    size_t kb = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = strtoull(line + 6, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb * 1024;
+}
+
+static size_t raiseFdLimit() {
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return limit.rlim_cur;
+}
+
+// 建立一个连接并完成一次 PING，返回 fd，失败返回 -1
+static int connectAndPing(const sockaddr_in& server, size_t index, bool loopback) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (loopback) {
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(0x7f000001 + static_cast<uint32_t>(index / kConnsPerSourceAddr % 255));
+        bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) < 0) {
+        close(fd);
+        return -1;
+    }
+    static const char kPing[] = "*1\r\n$4\r\nPING\r\n";
+    char reply[16];
+    if (write(fd, kPing, sizeof(kPing) - 1) != static_cast<ssize_t>(sizeof(kPing) - 1) ||
+        read(fd, reply, sizeof(reply)) <= 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <server pid> [connections=100000] [ip=127.0.0.1] [port=2000] [hold_seconds=0]\n", argv[0]);
+        return 1;
+    }
+    int pid = atoi(argv[1]);
+    size_t target = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+    const char* ip = argc > 3 ? argv[3] : "127.0.0.1";
+    int port = argc > 4 ? atoi(argv[4]) : 2000;
+    int hold = argc > 5 ? atoi(argv[5]) : 0;
+
+    size_t fd_limit = raiseFdLimit();
+    if (fd_limit < target + 16) {
+        printf("warning: RLIMIT_NOFILE=%zu, at most ~%zu connections\n", fd_limit, fd_limit - 16);
+    }
+    sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, ip, &server.sin_addr);
+    bool loopback = strncmp(ip, "127.", 4) == 0;
+
+    size_t base_rss = serverRssBytes(pid);
+    printf("server rss before: %.1f MB\n", static_cast<double>(base_rss) / 1048576.0);
+    std::vector<int> fds;
+    fds.reserve(target);
+    auto start = std::chrono::steady_clock::now();
+    size_t step = target >= 10 ? target / 10 : 1;
+    for (size_t i = 0; i < target; ++i) {
+        int fd = connectAndPing(server, i, loopback);
+        if (fd < 0) {
+            printf("connection %zu failed: %s\n", i, strerror(errno));
+            break;
+        }
+        fds.push_back(fd);
+        if (fds.size() % step == 0) {
+            size_t rss = serverRssBytes(pid);
+            printf("conns=%zu server_rss=%.1fMB bytes/conn=%.0f\n", fds.size(), static_cast<double>(rss) / 1048576.0,
+                   static_cast<double>(rss - base_rss) / static_cast<double>(fds.size()));
+        }
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // 等服务器处理完最后的事件再取最终 RSS
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    size_t rss = serverRssBytes(pid);
+    printf("idle conns=%zu connect+ping=%.2fs server_rss=%.1fMB bytes/conn=%.0f\n", fds.size(), sec,
+           static_cast<double>(rss) / 1048576.0,
+           fds.empty() ? 0.0 : static_cast<double>(rss - base_rss) / static_cast<double>(fds.size()));
+    if (hold > 0) {
+        std::this_thread::sleep_for(std::chrono::seconds(hold));
+    }
+    for (int fd : fds) close(fd);
+    return 0;
+}
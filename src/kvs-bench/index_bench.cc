@@ -0,0 +1,201 @@
+// 主键索引微基准：对比 std::unordered_map<std::string, Entry>（原实现）与
+// SwissIndex + SlotArray（当前实现）的每秒查找次数、每键内存，以及插入延迟的
+// p99.9 / 最大值（unordered_map 扩容时整体 rehash，SwissIndex 渐进式迁移）。
+// 计时前先检查渐进式迁移期间已插入的键都能查到，查不到时退出码为 1。
+// 用法: ./index_bench [键数量=1000000] [查找次数=10000000]
+// 例如: ./index_bench 1000000; ./index_bench 50000000
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "slot_array.h"
+#include "swiss_table.h"
+
+// 与分片中 Entry 大小相当的值部分
+struct Value {
+    std::string value;
+    int64_t expire_time = 0;
+    uint32_t charge = 0;
+    uint32_t meta = 0;
+};
+
+struct Record {
+    std::string key;
+    Value value;
+    uint64_t hash = 0;
+};
+
+// 按 2 的幂分桶的插入延迟直方图
+struct LatencyHistogram {
+    size_t buckets[64] = {0};
+    uint64_t max_ns = 0;
+    size_t count = 0;
+
+    void add(uint64_t ns) {
+        buckets[ns == 0 ? 0 : 64 - __builtin_clzll(ns)]++;
+        if (ns > max_ns) max_ns = ns;
+        ++count;
+    }
+    // 返回分位数所在桶的上界（纳秒）
+    uint64_t percentile(double p) const {
+        size_t target = static_cast<size_t>(static_cast<double>(count) * p);
+        size_t seen = 0;
+        for (int i = 0; i < 64; ++i) {
+            seen += buckets[i];
+            if (seen > target) return i == 0 ? 0 : (1ULL << i);
+        }
+        return max_ns;
+    }
+};
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point since) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+static size_t residentBytes() {
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(fp);
+    }
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+static std::string makeKey(size_t i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "key:%010zu", i);
+    return buf;
+}
+
+static void report(const char* name, size_t keys, size_t lookups, size_t bytes,
+                   double build_sec, double lookup_sec, size_t hits, const LatencyHistogram& insert) {
+    printf("%-14s keys=%zu build=%.2fs lookups/s=%.2fM bytes/key=%.1f hits=%zu "
+           "insert_p999<=%lluns insert_max=%.2fms\n",
+           name, keys, build_sec, static_cast<double>(lookups) / lookup_sec / 1e6,
+           static_cast<double>(bytes) / static_cast<double>(keys), hits,
+           static_cast<unsigned long long>(insert.percentile(0.999)), static_cast<double>(insert.max_ns) / 1e6);
+}
+
+static void benchUnorderedMap(size_t keys, size_t lookups) {
+    size_t base = residentBytes();
+    auto t0 = std::chrono::steady_clock::now();
+    std::unordered_map<std::string, Value> map;
+    LatencyHistogram insert;
+    for (size_t i = 0; i < keys; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        map[makeKey(i)].value = "value";
+        insert.add(elapsedNs(start));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    size_t bytes = residentBytes() - base;
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> probes(1 << 16);
+    for (auto& p : probes) p = makeKey(rng() % keys);
+    size_t hits = 0;
+    auto t2 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        hits += map.find(probes[i & (probes.size() - 1)]) != map.end();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    report("unordered_map", keys, lookups, bytes,
+           std::chrono::duration<double>(t1 - t0).count(),
+           std::chrono::duration<double>(t3 - t2).count(), hits, insert);
+}
+
+static void benchSwissIndex(size_t keys, size_t lookups) {
+    size_t base = residentBytes();
+    auto t0 = std::chrono::steady_clock::now();
+    SlotArray<Record> records;
+    SwissIndex index([&](uint32_t s) { return records[s].hash; });
+    std::hash<std::string> hasher;
+    LatencyHistogram insert;
+    for (size_t i = 0; i < keys; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t slot = static_cast<uint32_t>(records.size());
+        Record& r = records.push_back();
+        r.key = makeKey(i);
+        r.value.value = "value";
+        r.hash = hasher(r.key);
+        index.insert(r.hash, slot);
+        insert.add(elapsedNs(start));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    size_t bytes = residentBytes() - base;
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> probes(1 << 16);
+    for (auto& p : probes) p = makeKey(rng() % keys);
+    size_t hits = 0;
+    auto t2 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        const std::string& key = probes[i & (probes.size() - 1)];
+        hits += index.find(hasher(key), [&](uint32_t s) { return records[s].key == key; }) != SwissIndex::kNotFound;
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    report("swiss_index", keys, lookups, bytes,
+           std::chrono::duration<double>(t1 - t0).count(),
+           std::chrono::duration<double>(t3 - t2).count(), hits, insert);
+}
+
+// 逐个插入，迁移进行中（rehashing() 为真）每 16 次插入检查一遍已插入的所有键都能查到
+static bool checkRehashLookups(size_t keys) {
+    SlotArray<Record> records;
+    SwissIndex index([&](uint32_t s) { return records[s].hash; });
+    std::hash<std::string> hasher;
+    size_t checks = 0;
+    for (size_t i = 0; i < keys; ++i) {
+        uint32_t slot = static_cast<uint32_t>(records.size());
+        Record& r = records.push_back();
+        r.key = makeKey(i);
+        r.hash = hasher(r.key);
+        index.insert(r.hash, slot);
+        if (!index.rehashing() || i % 16 != 0) {
+            continue;
+        }
+        ++checks;
+        for (uint32_t s = 0; s <= slot; ++s) {
+            const std::string& key = records[s].key;
+            if (index.find(records[s].hash, [&](uint32_t f) { return records[f].key == key; }) != s) {
+                printf("rehash check FAILED: %s not found after %zu inserts\n", key.c_str(), i + 1);
+                return false;
+            }
+        }
+    }
+    printf("rehash check ok: %zu keys, %zu full scans during migration\n", keys, checks);
+    return true;
+}
+
+// 每种实现在独立子进程中运行，保证 RSS 统计互不干扰
+static void runIsolated(void (*bench)(size_t, size_t), size_t keys, size_t lookups) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        bench(keys, lookups);
+        fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+int main(int argc, char* argv[]) {
+    size_t keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t lookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+    if (keys == 0) keys = 1;
+    if (!checkRehashLookups(std::min<size_t>(keys, 1 << 16))) {
+        return 1;
+    }
+    fflush(stdout);  // 子进程会继承未输出的缓冲
+    runIsolated(benchUnorderedMap, keys, lookups);
+    runIsolated(benchSwissIndex, keys, lookups);
+    return 0;
+}
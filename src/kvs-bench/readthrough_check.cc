@@ -0,0 +1,149 @@
+// 读穿透检查：连接运行中的服务器（server_mode=proactor，已连接 MySQL），验证缓存未命中时
+// 回源的响应能送回客户端，并且同一连接上紧跟的请求在回源完成后才执行。
+// 只在 MySQL 中存在的键这样构造：SET key dbv PX 1 写穿透插入 MySQL，过期清理后缓存中没有该键。
+// 检查结束时 DEL 这些键（同时删除 MySQL 中的行）。
+// 用法: ./readthrough_check [ip=127.0.0.1] [端口=2000]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char kDbValue[] = "dbv";
+
+static std::string respCommand(const std::vector<std::string>& args) {
+    std::string cmd = "*" + std::to_string(args.size()) + "\r\n";
+    for (const std::string& arg : args) {
+        cmd += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return cmd;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 读一条 RESP 响应（简单字符串、错误、整数或 bulk string），超时或连接关闭时返回空串
+static std::string readReply(int fd, std::string* pending) {
+    while (true) {
+        size_t crlf = pending->find("\r\n");
+        if (crlf != std::string::npos) {
+            size_t total = crlf + 2;
+            if ((*pending)[0] == '$') {
+                long len = strtol(pending->c_str() + 1, NULL, 10);
+                if (len >= 0) total += static_cast<size_t>(len) + 2;
+            }
+            if (pending->size() >= total) {
+                std::string reply = pending->substr(0, total);
+                pending->erase(0, total);
+                return reply;
+            }
+        }
+        char buf[4096];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) return std::string();
+        pending->append(buf, static_cast<size_t>(n));
+    }
+}
+
+static std::string bulk(const std::string& value) {
+    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, const std::string& got) {
+    if (!ok) {
+        ++failures;
+        printf("FAILED: %s, got \"%s\"\n", what, got.empty() ? "<no reply>" : got.c_str());
+    }
+}
+
+// 让 key 只存在于 MySQL 中
+static void makeDbOnlyKey(int fd, std::string* pending, const std::string& key) {
+    sendAll(fd, respCommand({"SET", key, kDbValue, "PX", "1"}));
+    readReply(fd, pending);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
+
+int main(int argc, char* argv[]) {
+    const char* ip = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : 2000;
+
+    sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, ip, &server.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) < 0) {
+        perror("connect");
+        return 1;
+    }
+    // 回源的响应丢失时不要一直阻塞
+    timeval timeout;
+    timeout.tv_sec = 5;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string prefix = "readthrough_check:" + std::to_string(getpid()) + ":";
+    std::string pending;
+    std::vector<std::string> keys;
+    std::string got;
+
+    // 1. 未命中的 GET 回源后返回数据库中的值，之后流水线中的 PING 照常响应。
+    //    过期键还没被清理时第一次 GET 返回 nil 并删除它，再读一次即为未命中
+    std::string key = prefix + "miss";
+    keys.push_back(key);
+    makeDbOnlyKey(fd, &pending, key);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        sendAll(fd, respCommand({"GET", key}) + respCommand({"PING"}));
+        got = readReply(fd, &pending);
+        std::string pong = readReply(fd, &pending);
+        check(pong == "+PONG\r\n", "PING after read-through GET", pong);
+        if (got != "$-1\r\n") break;
+    }
+    check(got == bulk(kDbValue), "GET miss returns the MySQL value", got);
+
+    // 2. GET 未命中后紧跟同一个键的 SET：SET 在回源之后生效，回源的旧值不会覆盖它
+    bool deferred = false;
+    for (int attempt = 0; attempt < 3 && !deferred; ++attempt) {
+        key = prefix + "order" + std::to_string(attempt);
+        keys.push_back(key);
+        makeDbOnlyKey(fd, &pending, key);
+        sendAll(fd, respCommand({"GET", key}) + respCommand({"SET", key, "v2"}) + respCommand({"GET", key}));
+        got = readReply(fd, &pending);
+        deferred = got == bulk(kDbValue);
+        check(deferred || got == "$-1\r\n", "GET before SET", got);
+        got = readReply(fd, &pending);
+        check(got == "+OK\r\n", "SET after read-through GET", got);
+        got = readReply(fd, &pending);
+        check(got == bulk("v2"), "GET after SET sees the new value", got);
+    }
+    check(deferred, "pipelined GET went through read-through", "");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    sendAll(fd, respCommand({"GET", key}));
+    got = readReply(fd, &pending);
+    check(got == bulk("v2"), "SET value survives the read-through fill", got);
+
+    for (const std::string& k : keys) {
+        sendAll(fd, respCommand({"DEL", k}));
+        readReply(fd, &pending);
+    }
+    close(fd);
+    printf(failures == 0 ? "readthrough check ok\n" : "readthrough check FAILED (%d)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -5,9 +5,59 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <vector>
 
 using namespace std;
 
+// 二进制协议（与服务端 binary_protocol.h 一致）：20 字节帧头 + key + value，整数为网络字节序
+const uint8_t kBinaryRequestMagic = 0x80;
+const size_t kBinaryHeaderSize = 20;
+
+static void putU16(string& out, uint16_t v) {
+    v = htons(v);
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static void putU32(string& out, uint32_t v) {
+    v = htonl(v);
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static uint32_t getU32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+// 把一条 set/get/del 命令编码为二进制请求帧，格式错误返回 false
+static bool encodeBinaryCommand(const vector<string>& args, uint32_t opaque, string& out) {
+    uint8_t opcode = 0;
+    string value;
+    uint32_t ttl = 0;
+    if (args.size() >= 3 && args[0] == "set") {
+        opcode = 0x02;
+        value = args[2];
+        ttl = args.size() >= 4 ? static_cast<uint32_t>(stoul(args[3])) : 0;
+    } else if (args.size() >= 2 && args[0] == "get") {
+        opcode = 0x01;
+    } else if (args.size() >= 2 && args[0] == "del") {
+        opcode = 0x03;
+    } else {
+        return false;
+    }
+    const string& key = args[1];
+    out.push_back(static_cast<char>(kBinaryRequestMagic));
+    out.push_back(static_cast<char>(opcode));
+    putU16(out, 0);
+    putU32(out, static_cast<uint32_t>(key.size()));
+    putU32(out, static_cast<uint32_t>(value.size()));
+    putU32(out, ttl);
+    putU32(out, opaque);
+    out += key;
+    out += value;
+    return true;
+}
+
 // 连接服务器并发送命令，返回响应
 string sendCommand(const string& serverAddr, int port, const string& command) {
     // 创建 TCP socket
@@ -50,6 +100,63 @@ string sendCommand(const string& serverAddr, int port, const string& command) {
     return string(buffer, bytesRead);
 }
 
+// 二进制协议：所有命令一次性发送（pipelining），再按 opaque 逐个读取响应
+int sendBinaryCommands(const string& serverAddr, int port, const vector<vector<string>>& commands) {
+    string request;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        if (!encodeBinaryCommand(commands[i], static_cast<uint32_t>(i), request)) {
+            cout << "ERROR: 命令格式错误(set <key> <value> [ttl] / get <key> / del <key>)" << endl;
+            return 1;
+        }
+    }
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in servAddr;
+    memset(&servAddr, 0, sizeof(servAddr));
+    servAddr.sin_family = AF_INET;
+    servAddr.sin_port = htons(port);
+    if (sockfd < 0 || inet_pton(AF_INET, serverAddr.c_str(), &servAddr.sin_addr) <= 0 ||
+        connect(sockfd, (struct sockaddr*)&servAddr, sizeof(servAddr)) < 0) {
+        cout << "ERROR: 连接服务器失败" << endl;
+        if (sockfd >= 0) close(sockfd);
+        return 1;
+    }
+    if (send(sockfd, request.data(), request.size(), 0) < 0) {
+        cout << "ERROR: 发送命令失败" << endl;
+        close(sockfd);
+        return 1;
+    }
+
+    static const char* kStatusNames[] = {"OK", "NOT_FOUND", "EXPIRED", "ERROR"};
+    string buffer;
+    size_t received = 0;
+    char chunk[4096];
+    while (received < commands.size()) {
+        if (buffer.size() >= kBinaryHeaderSize) {
+            uint16_t status = static_cast<uint16_t>(
+                (static_cast<uint8_t>(buffer[2]) << 8) | static_cast<uint8_t>(buffer[3]));
+            uint32_t value_len = getU32(buffer.data() + 8);
+            uint32_t opaque = getU32(buffer.data() + 16);
+            if (buffer.size() >= kBinaryHeaderSize + value_len) {
+                cout << "[" << opaque << "] " << (status < 4 ? kStatusNames[status] : "UNKNOWN")
+                     << " " << buffer.substr(kBinaryHeaderSize, value_len) << endl;
+                buffer.erase(0, kBinaryHeaderSize + value_len);
+                ++received;
+                continue;
+            }
+        }
+        ssize_t n = recv(sockfd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            cout << "ERROR: 接收响应失败" << endl;
+            close(sockfd);
+            return 1;
+        }
+        buffer.append(chunk, n);
+    }
+    close(sockfd);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 4) {
         cout << "使用方法: ./kvs_client <服务器地址> <端口> <命令> [参数...]" << endl;
@@ -57,9 +164,27 @@ int main(int argc, char* argv[]) {
         cout << "  设置键值: ./kvs_client 127.0.0.1 2000 set myKey myValue" << endl;
         cout << "  获取键值: ./kvs_client 127.0.0.1 2000 get myKey" << endl;
         cout << "  删除键值: ./kvs_client 127.0.0.1 2000 del myKey" << endl;
+        cout << "  二进制协议批量发送: ./kvs_client --binary 127.0.0.1 2000 set a 1 \\; get a \\; del a" << endl;
         return 1;
     }
 
+    if (string(argv[1]) == "--binary") {
+        if (argc < 5) {
+            cout << "使用方法: ./kvs_client --binary <服务器地址> <端口> <命令> [参数...] [\\; <命令> ...]" << endl;
+            return 1;
+        }
+        // 以单独的 ";" 分隔多条命令
+        vector<vector<string>> commands(1);
+        for (int i = 4; i < argc; ++i) {
+            if (string(argv[i]) == ";") {
+                commands.emplace_back();
+            } else {
+                commands.back().push_back(argv[i]);
+            }
+        }
+        return sendBinaryCommands(argv[2], stoi(argv[3]), commands);
+    }
+
     string serverAddr = argv[1];
     int port = stoi(argv[2]);
     string command;
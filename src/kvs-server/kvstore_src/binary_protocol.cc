@@ -0,0 +1,140 @@
+#include "binary_protocol.h"
+#include <string.h>
+#include <arpa/inet.h>
+#include <string>
+#include "command_handler.h"
+
+namespace {
+
+uint16_t loadU16(const char* p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohs(v);
+}
+
+uint32_t loadU32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+void storeU16(char* p, uint16_t v) {
+    v = htons(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+void storeU32(char* p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// 执行一个完整的请求帧，key / value 指向输入缓冲区
+void executeBinaryFrame(const BinaryHeader& header, const char* key, const char* value,
+                        muduo::net::Buffer* output, ZeroCopyRefs* zc) {
+    std::string_view k(key, header.key_len);
+    switch (header.opcode) {
+        case kBinaryGet: {
+            // 命中时在分片锁内直接编码响应，值只从存储拷贝一次到 output；共享存储的大值只记录引用
+            CommandStatus status = executeGetWith(k, [&](std::string_view result, const SharedValue& owner) {
+                appendBinaryResponseHeader(output, header.opcode, kStatusOk, header.opaque, result.size());
+                appendValue(output, result, owner, zc);
+            });
+            if (status != kStatusOk) {
+                appendBinaryResponse(output, header.opcode, status, header.opaque, nullptr, 0);
+            }
+            break;
+        }
+        case kBinarySet: {
+            std::string_view v(value, header.value_len);
+            CommandStatus status = executeSet(k, v, std::chrono::seconds(header.ttl));
+            appendBinaryResponse(output, header.opcode, status, header.opaque, nullptr, 0);
+            break;
+        }
+        case kBinaryDel: {
+            CommandStatus status = executeDel(k);
+            appendBinaryResponse(output, header.opcode, status, header.opaque, nullptr, 0);
+            break;
+        }
+        default: {
+            static const char kMessage[] = "ERROR: unknown opcode";
+            appendBinaryResponse(output, header.opcode, kStatusError, header.opaque,
+                                 kMessage, sizeof(kMessage) - 1);
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+BinaryHeader decodeBinaryHeader(const char* data) {
+    BinaryHeader header;
+    header.magic = static_cast<uint8_t>(data[0]);
+    header.opcode = static_cast<uint8_t>(data[1]);
+    header.status = loadU16(data + 2);
+    header.key_len = loadU32(data + 4);
+    header.value_len = loadU32(data + 8);
+    header.ttl = loadU32(data + 12);
+    header.opaque = loadU32(data + 16);
+    return header;
+}
+
+void encodeBinaryHeader(const BinaryHeader& header, char* data) {
+    data[0] = static_cast<char>(header.magic);
+    data[1] = static_cast<char>(header.opcode);
+    storeU16(data + 2, header.status);
+    storeU32(data + 4, header.key_len);
+    storeU32(data + 8, header.value_len);
+    storeU32(data + 12, header.ttl);
+    storeU32(data + 16, header.opaque);
+}
+
+void appendBinaryResponseHeader(muduo::net::Buffer* output, uint8_t opcode, uint16_t status, uint32_t opaque,
+                                size_t value_len) {
+    BinaryHeader header;
+    header.magic = kBinaryResponseMagic;
+    header.opcode = opcode;
+    header.status = status;
+    header.value_len = static_cast<uint32_t>(value_len);
+    header.opaque = opaque;
+    output->ensureWritableBytes(kBinaryHeaderSize);
+    encodeBinaryHeader(header, output->beginWrite());
+    output->hasWritten(kBinaryHeaderSize);
+}
+
+void appendBinaryResponse(muduo::net::Buffer* output, uint8_t opcode, uint16_t status, uint32_t opaque,
+                          const char* value, size_t value_len) {
+    output->ensureWritableBytes(kBinaryHeaderSize + value_len);
+    appendBinaryResponseHeader(output, opcode, status, opaque, value_len);
+    if (value_len > 0) {
+        output->append(value, value_len);
+    }
+}
+
+bool processBinaryFrames(muduo::net::Buffer* input, muduo::net::Buffer* output, ZeroCopyRefs* zc) {
+    while (input->readableBytes() >= kBinaryHeaderSize) {
+        const char* data = input->peek();
+        if (static_cast<uint8_t>(data[0]) != kBinaryRequestMagic) {
+            return true;  // 交给文本协议处理
+        }
+        BinaryHeader header = decodeBinaryHeader(data);
+        if (header.key_len > kBinaryMaxKeyLength || header.value_len > kBinaryMaxValueLength) {
+            return false;
+        }
+        size_t frame_len = kBinaryHeaderSize + header.key_len + header.value_len;
+        if (input->readableBytes() < frame_len) {
+            // 帧不完整：预留好剩余空间，下次读取直接读到缓冲区末尾
+            input->ensureWritableBytes(frame_len - input->readableBytes());
+            return true;
+        }
+        const char* key = data + kBinaryHeaderSize;
+        size_t mark = output->readableBytes();
+        executeBinaryFrame(header, key, key + header.key_len, output, zc);
+        if (dbCacheDeferred()) {
+            // 需要回源数据库：撤销这一帧的响应，帧留在 input 中交给 DB 线程池执行
+            output->unwrite(output->readableBytes() - mark);
+            return true;
+        }
+        input->retrieve(frame_len);
+    }
+    return true;
+}
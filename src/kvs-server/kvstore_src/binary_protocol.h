@@ -0,0 +1,62 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "muduo/net/Buffer.h"
+
+struct ZeroCopyRefs;
+
+// 定长帧头的二进制协议，所有整数为网络字节序：
+//
+//   0       1       2               4               8               12              16              20
+//   +-------+-------+-------+-------+---------------+---------------+---------------+---------------+
+//   | magic |opcode |    status     |    key_len    |   value_len   |      ttl      |    opaque     |
+//   +-------+-------+-------+-------+---------------+---------------+---------------+---------------+
+//   | key (key_len 字节) | value (value_len 字节) |
+//
+// 请求 magic 为 0x80，响应为 0x81；opaque 是客户端自定义的请求 id，响应原样带回，
+// 因此客户端可以在一个连接上连续发送多个请求（pipelining），按 opaque 匹配响应。
+// 响应中 key_len 为 0，value 为 GET 的结果或错误信息，ttl 为 0。
+
+const uint8_t kBinaryRequestMagic = 0x80;
+const uint8_t kBinaryResponseMagic = 0x81;
+const size_t kBinaryHeaderSize = 20;
+const uint32_t kBinaryMaxKeyLength = 64 * 1024;
+const uint32_t kBinaryMaxValueLength = 64 * 1024 * 1024;
+
+enum BinaryOpcode {
+    kBinaryGet = 0x01,
+    kBinarySet = 0x02,
+    kBinaryDel = 0x03,
+};
+
+struct BinaryHeader {
+    uint8_t magic = 0;
+    uint8_t opcode = 0;
+    uint16_t status = 0;
+    uint32_t key_len = 0;
+    uint32_t value_len = 0;
+    uint32_t ttl = 0;
+    uint32_t opaque = 0;
+};
+
+// 从 data 解码帧头（调用方保证至少 kBinaryHeaderSize 字节）
+BinaryHeader decodeBinaryHeader(const char* data);
+// 把帧头编码到 data（kBinaryHeaderSize 字节）
+void encodeBinaryHeader(const BinaryHeader& header, char* data);
+
+// 追加一个响应帧的帧头，value_len 字节的值由调用方随后追加
+void appendBinaryResponseHeader(muduo::net::Buffer* output, uint8_t opcode, uint16_t status, uint32_t opaque,
+                                size_t value_len);
+// 追加一个响应帧
+void appendBinaryResponse(muduo::net::Buffer* output, uint8_t opcode, uint16_t status, uint32_t opaque,
+                          const char* value, size_t value_len);
+
+// 从 input 中取出并执行所有完整的二进制请求帧，响应依次追加到 output；
+// 不完整的帧留在 input 中等待后续数据，遇到非二进制帧时停止。
+// 帧头非法（magic / 长度超限）时返回 false，调用方应关闭连接。
+// zc 非空时 GET 命中的大值只在 zc 中记录引用（见 zero_copy.h）。
+bool processBinaryFrames(muduo::net::Buffer* input, muduo::net::Buffer* output, ZeroCopyRefs* zc = nullptr);
+
+#endif
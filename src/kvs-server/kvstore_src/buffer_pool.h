@@ -0,0 +1,42 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include "muduo/net/Buffer.h"
+
+// 连接读写缓冲区的空闲池，非线程安全，由事件循环线程独占使用。
+// 连接有数据要处理时才取出缓冲区，处理完、发送完后归还，空闲连接不占用缓冲区。
+// 超过 kMaxPooledBytes 的缓冲区（处理过大请求或响应）直接释放，池中最多保留 kMaxPooled 个，
+// 避免突发流量后长期占用内存
+class BufferPool {
+public:
+    static const size_t kMaxPooled = 4096;
+    static const size_t kMaxPooledBytes = 64 * 1024;
+
+    std::unique_ptr<muduo::net::Buffer> acquire() {
+        if (free_.empty()) {
+            return std::unique_ptr<muduo::net::Buffer>(new muduo::net::Buffer());
+        }
+        std::unique_ptr<muduo::net::Buffer> buffer = std::move(free_.back());
+        free_.pop_back();
+        return buffer;
+    }
+
+    void release(std::unique_ptr<muduo::net::Buffer> buffer) {
+        if (!buffer) {
+            return;
+        }
+        if (free_.size() >= kMaxPooled || buffer->internalCapacity() > kMaxPooledBytes) {
+            return;
+        }
+        buffer->retrieveAll();
+        free_.push_back(std::move(buffer));
+    }
+
+private:
+    std::vector<std::unique_ptr<muduo::net::Buffer>> free_;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef COARSE_CLOCK_H
+#define COARSE_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// 进程内共享的粗粒度单调时钟（毫秒）：后台线程每个周期把 steady_clock 写入一个原子变量，
+// 热路径上的 TTL 判断只做一次 relaxed 读取，不再每次请求调用 system_clock::now()，
+// 也不受 NTP 调整墙上时间的影响。ticker 启动前直接读 steady_clock。
+class CoarseClock {
+public:
+    // 读数可能落后真实时间一个更新周期
+    static uint64_t nowMs() {
+        if (running_.load(std::memory_order_relaxed)) {
+            return now_ms_.load(std::memory_order_relaxed);
+        }
+        return preciseMs();
+    }
+
+    // 不经过缓存直接读取单调时钟
+    static uint64_t preciseMs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // 单调时钟毫秒数与墙上时间的换算，只用于持久化（落盘的过期时间需要跨进程有效）
+    static int64_t toWallMs(uint64_t ms) {
+        return wallNowMs() + (static_cast<int64_t>(ms) - static_cast<int64_t>(preciseMs()));
+    }
+    static uint64_t fromWallMs(int64_t wall_ms) {
+        int64_t ms = static_cast<int64_t>(preciseMs()) + (wall_ms - wallNowMs());
+        return ms > 0 ? static_cast<uint64_t>(ms) : 0;
+    }
+
+    // 启动后台更新线程，重复调用只启动一次
+    static void start(std::chrono::milliseconds interval = std::chrono::milliseconds(1)) {
+        static std::once_flag once;
+        std::call_once(once, [interval]() {
+            now_ms_.store(preciseMs(), std::memory_order_relaxed);
+            running_.store(true, std::memory_order_relaxed);
+            std::thread([interval]() {
+                while (true) {
+                    std::this_thread::sleep_for(interval);
+                    now_ms_.store(preciseMs(), std::memory_order_relaxed);
+                }
+            }).detach();
+        });
+    }
+
+    // 当前墙上时间（毫秒）
+    static int64_t wallNowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    static inline std::atomic<uint64_t> now_ms_{0};
+    static inline std::atomic<bool> running_{false};
+};
+
+#endif
@@ -1,129 +1,225 @@
 #include "command_handler.h"
-#include <sstream>
-#include <iostream>
-#include <vector>
-#include <cstring>
-#include "db_pool.h"
+#include <charconv>
+#include "binary_protocol.h"
+#include "command_table.h"
 
-// 分割字符串为命令参数（类似 kvs_split_token）
-static std::vector<std::string> splitCommand(const std::string& command) {
-    std::istringstream iss(command);
-    std::vector<std::string> tokens;
-    std::string token;
-    while (iss >> token) {
-        tokens.push_back(token);
+namespace {
+
+const size_t kMaxTextTokens = 8;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// 按空白切分，最多 kMaxTextTokens 个参数，返回参数个数
+size_t splitCommand(std::string_view command, std::string_view* tokens) {
+    size_t count = 0;
+    size_t pos = 0;
+    while (count < kMaxTextTokens) {
+        while (pos < command.size() && isSpace(command[pos])) {
+            ++pos;
+        }
+        if (pos == command.size()) {
+            break;
+        }
+        size_t start = pos;
+        while (pos < command.size() && !isSpace(command[pos])) {
+            ++pos;
+        }
+        tokens[count++] = command.substr(start, pos - start);
     }
-    return tokens;
+    return count;
 }
 
-int handleCommand(const std::string& command, std::string& response) {
-    auto tokens = splitCommand(command);
-    if (tokens.empty()) {
-        response = "ERROR: 无效命令";
-        return -1;
+void appendText(muduo::net::Buffer* output, std::string_view text) {
+    output->append(text.data(), text.size());
+}
+
+bool textError(muduo::net::Buffer* output, std::string_view message) {
+    appendText(output, message);
+    return false;
+}
+
+}  // namespace
+
+CommandStatus executeSet(std::string_view key, std::string_view value, std::chrono::milliseconds ttl,
+                         SetResult* result) {
+    // 调用带结果反馈的 set 方法
+    SetResult res = KVStore::getInstance().set(key, value, ttl);
+    if (result) {
+        *result = res;
+    }
+    if (!res.overwritten) {
+        dbCacheInsert(key, value);
     }
+    return kStatusOk;
+}
 
+CommandStatus executeGet(std::string_view key, std::string& value) {
+    return executeGetWith(key, [&value](std::string_view v) { value.assign(v.data(), v.size()); });
+}
 
-    KVStore& kv = KVStore::getInstance();  // 获取单例 KVStore
-    const std::string& cmd = tokens[0];
+CommandStatus executeDel(std::string_view key) {
+    // 调用带返回值的 del 方法
+    bool success = KVStore::getInstance().del(key);
+    if (success) {
+        dbCacheDelete(key);
+    }
+    return success ? kStatusOk : kStatusNotFound;
+}
 
-    if (cmd == "set") {
-        if (tokens.size() < 3) {
-            response = "ERROR: 格式错误(set <key> <value> [ttl_seconds])";
-            return -1;
-        }
-        cout << "key: " << tokens[1] << " value: " << tokens[2] << endl;
-        std::string key = tokens[1];
-        std::string value = tokens[2];
-        std::chrono::seconds ttl = std::chrono::seconds(0);  // 默认无过期时间
-        if (tokens.size() >= 4) {  // 支持可选的 ttl 参数（秒）
-            try {
-                ttl = std::chrono::seconds(std::stoi(tokens[3]));
-            } catch (...) {
-                response = "ERROR: ttl 必须为整数（秒）";
-                return -1;
+bool handleTextCommand(std::string_view command, muduo::net::Buffer* output) {
+    std::string_view tokens[kMaxTextTokens];
+    size_t count = splitCommand(command, tokens);
+    if (count == 0) {
+        return textError(output, "ERROR: 无效命令");
+    }
+
+    switch (lookupCommand(tokens[0])) {
+        case kCmdSet: {
+            if (count < 3) {
+                return textError(output, "ERROR: 格式错误(set <key> <value> [ttl_seconds])");
+            }
+            std::chrono::seconds ttl = std::chrono::seconds(0);  // 默认无过期时间
+            if (count >= 4) {  // 支持可选的 ttl 参数（秒）
+                int seconds = 0;
+                const char* begin = tokens[3].data();
+                if (*begin == '+') {
+                    ++begin;
+                }
+                auto parsed = std::from_chars(begin, tokens[3].data() + tokens[3].size(), seconds);
+                if (parsed.ec != std::errc()) {
+                    return textError(output, "ERROR: ttl 必须为整数（秒）");
+                }
+                ttl = std::chrono::seconds(seconds);
             }
+            SetResult res;
+            executeSet(tokens[1], tokens[2], ttl, &res);
+            // 构造包含操作结果的响应
+            appendText(output, "OK");
+            if (res.overwritten) appendText(output, " (覆盖旧键)");
+            if (res.evicted) appendText(output, " (淘汰旧键)");
+            return true;
         }
-        // 调用带结果反馈的 set 方法
-        SetResult res = kv.set(key, value, ttl);
-        cout << "set res: " << res.overwritten << " " << res.evicted << endl;
-        // 构造包含操作结果的响应
-        response = "OK";
-        if (res.overwritten) response += " (覆盖旧键)";
-        if (res.evicted) response += " (淘汰旧键)";
-        if (!res.overwritten) {
-            // 存储映射关系到 MySQL
-            CDBManager *db_manager = CDBManager::getInstance();
-            CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
-            AUTO_REL_DBCONN(db_manager, db_conn);
-            std::string str_sql = FormatString("insert into student (name, number) values ('%s', '%s')", 
-            key.c_str(), value.c_str());
-            cout << "执行：" << str_sql;
-            if (!db_conn->ExecuteCreate(str_sql.c_str())) {
-            cout << str_sql << " 操作失败";
-            } 
+        case kCmdGet: {
+            if (count < 2) {
+                return textError(output, "ERROR: 格式错误(get <key>)");
+            }
+            CommandStatus status = executeGetWith(tokens[1], [output](std::string_view value) {
+                appendText(output, value);  // 返回实际值
+            });
+            if (status == kStatusNotFound) {
+                appendText(output, "NOT_FOUND");
+            } else if (status == kStatusExpired) {
+                appendText(output, "EXPIRED");
+            }
+            return true;
         }
-    } else if (cmd == "get") {
-        if (tokens.size() < 2) {
-            response = "ERROR: 格式错误(get <key>)";
-            return -1;
+        case kCmdDel: {
+            if (count < 2) {
+                return textError(output, "ERROR: 格式错误(del <key>)");
+            }
+            appendText(output, executeDel(tokens[1]) == kStatusOk ? "OK" : "NOT_FOUND");
+            return true;
         }
-        std::string key = tokens[1];
-        // 调用带结果反馈的 get 方法
-        GetResult res = kv.get(key);
-        if (!res.exists) {
-            CDBManager *db_manager = CDBManager::getInstance();
-            CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
-            AUTO_REL_DBCONN(db_manager, db_conn);
-            std::string str_sql = FormatString("select number from student where name = '%s'", key.c_str());
-            CResultSet * result_set = db_conn->ExecuteQuery(str_sql.c_str());
-            if (result_set->Next()) {  // 确保有数据行
-        // 添加字段存在性检查
-                response = result_set->GetString("number");
-                    // 将结果缓存到本地
-                KVStore::getInstance().set(key, response, std::chrono::minutes(60));
+        default:
+            return textError(output, "ERROR: 未知命令(支持 set/get/del)");
+    }
+}
+
+int handleCommand(const std::string& command, std::string& response) {
+    muduo::net::Buffer output;
+    bool ok = handleTextCommand(command, &output);
+    response = output.retrieveAllAsString();
+    return ok ? static_cast<int>(response.size()) : -1;  // 返回响应长度
+}
+
+bool handleInput(muduo::net::Buffer* input, muduo::net::Buffer* output, ProtocolState* state) {
+    while (input->readableBytes() > 0) {
+        char first = *input->peek();
+        if (static_cast<uint8_t>(first) == kBinaryRequestMagic || first == kRespArrayPrefix) {
+            size_t before = input->readableBytes();
+            bool ok = first == kRespArrayPrefix ? processRespCommands(input, output, &state->resp, state->zerocopy)
+                                                : processBinaryFrames(input, output, state->zerocopy);
+            if (!ok) {
+                return false;
             }
-            else {
-                response = "NOT_FOUND";
+            if (dbCacheTakeDeferred()) {
+                state->db_deferred = true;
+                break;
             }
-        } else if (res.expired) {
-            response = "EXPIRED";
-        } else {
-            response = res.value;  // 返回实际值
-        }
-    } else if (cmd == "del") {
-        if (tokens.size() < 2) {
-            response = "ERROR: 格式错误(del <key>)";
-            return -1;
+            if (input->readableBytes() == before) {
+                break;  // 请求不完整，等待更多数据
+            }
+            continue;
         }
-        std::string key = tokens[1];
-        // 调用带返回值的 del 方法
-        bool success = kv.del(key);
-        response = success ? "OK" : "NOT_FOUND";
-        if (success) {
-            CDBManager *db_manager = CDBManager::getInstance();
-            CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
-            AUTO_REL_DBCONN(db_manager, db_conn);
-            std::string str_sql = FormatString("delete from student where name = '%s'", key.c_str());
-            CResultSet * result_set = db_conn->ExecuteQuery(str_sql.c_str());
+        // 文本协议没有分帧，沿用原来的约定：一次读到的数据就是一条命令
+        size_t mark = output->readableBytes();
+        handleTextCommand(std::string_view(input->peek(), input->readableBytes()), output);
+        if (dbCacheTakeDeferred()) {
+            output->unwrite(output->readableBytes() - mark);
+            state->db_deferred = true;
+            break;
         }
-    } else {
-        response = "ERROR: 未知命令(支持 set/get/del)";
-        return -1;
+        input->retrieveAll();
     }
-
-    return response.size();  // 返回响应长度
+    return true;
 }
 
-int commandHandler(char* msg, int length, char* response) {
-    std::string command(msg, length);  // 将原始字符数组转为字符串
-    std::string resp;
-    std::cout << "command: " << command << std::endl;
-    int ret = handleCommand(command, resp);  // 调用命令处理函数
-    std::cout << "resp: " << resp << std::endl;
-    if (ret > 0) {
-        strncpy(response, resp.c_str(), resp.size());  // 将响应复制到发送缓冲区
-        return resp.size();
+RouteKind routeRequest(const char* data, size_t len, ProtocolState* state, RequestRoute* route) {
+    if (static_cast<uint8_t>(data[0]) == kBinaryRequestMagic) {
+        if (len < kBinaryHeaderSize) {
+            return kRouteIncomplete;
+        }
+        BinaryHeader header = decodeBinaryHeader(data);
+        if (header.key_len > kBinaryMaxKeyLength || header.value_len > kBinaryMaxValueLength) {
+            route->length = len;  // 非法帧头由 handleInput 报错并关闭连接
+            return kRouteBarrier;
+        }
+        size_t frame_len = kBinaryHeaderSize + header.key_len + header.value_len;
+        if (len < frame_len) {
+            return kRouteIncomplete;
+        }
+        route->length = frame_len;
+        if (header.opcode != kBinaryGet && header.opcode != kBinarySet && header.opcode != kBinaryDel) {
+            return kRouteNoKey;
+        }
+        route->key = std::string_view(data + kBinaryHeaderSize, header.key_len);
+        return kRouteKey;
     }
-    return ret;
-}
\ No newline at end of file
+    if (data[0] == kRespArrayPrefix) {
+        std::vector<std::string_view>& args = state->resp.args;
+        size_t consumed = 0;
+        RespParseStatus status = parseRespCommand(data, len, &args, &consumed);
+        if (status == kRespIncomplete) {
+            return kRouteIncomplete;
+        }
+        if (status == kRespError) {
+            route->length = len;
+            return kRouteBarrier;
+        }
+        route->length = consumed;
+        switch (lookupCommand(args[0])) {
+            case kCmdGet:
+            case kCmdSet:
+                if (args.size() < 2) {
+                    return kRouteNoKey;  // 参数错误，只返回错误信息
+                }
+                route->key = args[1];
+                return kRouteKey;
+            case kCmdDel:
+            case kCmdExists:
+                if (args.size() == 2) {
+                    route->key = args[1];
+                    return kRouteKey;
+                }
+                return args.size() < 2 ? kRouteNoKey : kRouteBarrier;
+            case kCmdQuit:
+                return kRouteBarrier;
+            default:
+                return kRouteNoKey;
+        }
+    }
+    route->length = len;  // 文本协议：已读到的数据就是一条命令
+    return kRouteBarrier;
+}
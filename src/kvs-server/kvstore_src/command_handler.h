@@ -2,13 +2,87 @@
 #define COMMAND_HANDLER_H
 
 #include <string>
+#include <string_view>
 #include "kvstore.h"  // 依赖 KVStore 类
+#include "muduo/net/Buffer.h"
+#include "resp_protocol.h"
+#include "db_cache.h"
+#include "zero_copy.h"
+
+// 命令的执行结果，文本协议和二进制协议共用
+enum CommandStatus {
+    kStatusOk = 0,
+    kStatusNotFound = 1,
+    kStatusExpired = 2,
+    kStatusError = 3,
+};
+
+// 执行单条命令（含 MySQL 读穿透和写穿透），不涉及协议编码
+CommandStatus executeSet(std::string_view key, std::string_view value, std::chrono::milliseconds ttl,
+                         SetResult* result = nullptr);
+CommandStatus executeGet(std::string_view key, std::string& value);
+CommandStatus executeDel(std::string_view key);
+
+// GET 的零拷贝版本：命中时在分片锁内以 string_view 调用 sink(value) 或 sink(value, owner)，
+// 调用方直接把值编码进连接的输出缓冲区；缓存未命中时回源 MySQL，找到后同样调用 sink（owner 为空）
+template <typename Sink>
+CommandStatus executeGetWith(std::string_view key, Sink&& sink) {
+    GetResult res = KVStore::getInstance().getWith(key, sink);
+    if (res.exists) {
+        return res.expired ? kStatusExpired : kStatusOk;
+    }
+    std::string value;
+    if (!dbCacheLoad(key, &value)) {
+        return kStatusNotFound;
+    }
+    // 将结果缓存到本地；异步回源期间同一个键可能已被写入，不用数据库中的旧值覆盖
+    KVStore::getInstance().fill(key, value, std::chrono::minutes(60));
+    invokeValueSink(sink, std::string_view(value), SharedValue());
+    return kStatusOk;
+}
+
+// 文本协议：在 command 上原地切分参数（string_view，不分配内存），经命令表分发，
+// 响应直接追加到 output；命令错误时返回 false（output 中为错误信息）
+bool handleTextCommand(std::string_view command, muduo::net::Buffer* output);
 
 // 处理客户端命令并生成响应
-// 参数：原始命令字符串，输出响应字符串
+// 参数：原始命令字符串，输出响应字符串（长度不受限制）
 // 返回：响应长度（成功）或 -1（失败）
 int handleCommand(const std::string& command, std::string& response);
-int commandHandler(char* msg, int length, char* response);
+
+// 连接级的协议状态，由服务器为每个连接保存一份
+struct ProtocolState {
+    RespSession resp;
+    // 输出缓冲区对应的大值引用表，非空时共享存储中的大值只记录引用，由服务器聚集写或零拷贝发送；
+    // 为空时照常拷贝
+    ZeroCopyRefs* zerocopy = nullptr;
+    // handleInput 停在一条需要回源数据库的请求上（异步模式，见 db_cache.h），请求还在 input 开头
+    bool db_deferred = false;
+};
+
+// 处理连接输入缓冲区中已到达的请求，响应追加到 output（一次读取的所有响应合并为一次写）。
+// 按每个请求的首字节识别协议：0x80 为二进制协议，'*' 为 RESP，两者都支持 pipelining，
+// 不完整的请求留在 input 中；其他按文本协议把已读到的数据当作一条命令。
+// 返回 false 表示协议错误或客户端要求断开，发送完 output 后应关闭连接。
+// 当前线程异步访问数据库时，遇到需要回源的请求就停下并设置 state->db_deferred，
+// 服务器把这条请求（长度由 routeRequest 给出）交给 DB 线程池执行后再继续处理之后的请求。
+bool handleInput(muduo::net::Buffer* input, muduo::net::Buffer* output, ProtocolState* state);
+
+// 请求的路由类别，每核一个 io_uring 的 proactor 据此决定请求在哪个线程执行
+enum RouteKind {
+    kRouteIncomplete,  // 第一条请求还不完整
+    kRouteNoKey,       // 不访问存储（PING / HELLO 等），在当前线程执行
+    kRouteKey,         // 只访问一个键，可以转发给拥有该键所在分片的线程
+    kRouteBarrier,     // 多键命令、文本协议或协议错误：等该连接之前转发的请求完成后在当前线程执行
+};
+
+struct RequestRoute {
+    size_t length = 0;     // 第一条请求的字节数
+    std::string_view key;  // kRouteKey 时为请求的键，指向 data 内部
+};
+
+// 只解析不执行 data 中的第一条请求，按 handleInput 相同的规则识别协议
+RouteKind routeRequest(const char* data, size_t len, ProtocolState* state, RequestRoute* route);
 
 template <typename... Args>
 std::string FormatString(const std::string &format, Args... args) {
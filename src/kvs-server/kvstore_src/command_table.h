@@ -0,0 +1,119 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <string_view>
+
+// 命令名到命令编号的编译期完美哈希表，文本协议和 RESP 共用。
+// 编译期在若干种子中搜索一个让所有命令名落到不同桶的种子，找不到时 static_assert 报错；
+// 运行时查找只需一次哈希和一次不区分大小写的比较，不分配内存。
+enum CommandId : uint8_t {
+    kCmdUnknown = 0,
+    kCmdGet,
+    kCmdSet,
+    kCmdDel,
+    kCmdExists,
+    kCmdPing,
+    kCmdEcho,
+    kCmdHello,
+    kCmdQuit,
+    kCmdConfig,
+    kCmdCommand,
+    kCmdInfo,
+    kCmdBgRewriteAof,
+};
+
+struct CommandSpec {
+    std::string_view name;  // 小写命令名
+    CommandId id;
+};
+
+constexpr CommandSpec kCommandSpecs[] = {
+    {"get", kCmdGet},
+    {"set", kCmdSet},
+    {"del", kCmdDel},
+    {"exists", kCmdExists},
+    {"ping", kCmdPing},
+    {"echo", kCmdEcho},
+    {"hello", kCmdHello},
+    {"quit", kCmdQuit},
+    {"config", kCmdConfig},
+    {"command", kCmdCommand},
+    {"info", kCmdInfo},
+    {"bgrewriteaof", kCmdBgRewriteAof},
+};
+
+constexpr size_t kCommandCount = sizeof(kCommandSpecs) / sizeof(kCommandSpecs[0]);
+constexpr size_t kCommandTableSize = 32;  // 2 的幂，大于命令数
+constexpr size_t kCommandMaxLength = 16;
+constexpr uint8_t kCommandEmpty = 0xff;
+
+constexpr char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+}
+
+// 不区分大小写的 FNV-1a 变体
+constexpr uint32_t commandHash(std::string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name) {
+        h = (h ^ static_cast<uint8_t>(toLowerAscii(c))) * 16777619u;
+    }
+    return (h ^ (h >> 15)) & (kCommandTableSize - 1);
+}
+
+constexpr uint32_t findCommandSeed() {
+    for (uint32_t seed = 1; seed < 100000; ++seed) {
+        bool used[kCommandTableSize] = {};
+        bool ok = true;
+        for (size_t i = 0; i < kCommandCount && ok; ++i) {
+            uint32_t bucket = commandHash(kCommandSpecs[i].name, seed);
+            ok = !used[bucket];
+            used[bucket] = true;
+        }
+        if (ok) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t kCommandSeed = findCommandSeed();
+static_assert(kCommandSeed != 0, "no perfect hash seed for the command table");
+
+constexpr std::array<uint8_t, kCommandTableSize> buildCommandTable() {
+    std::array<uint8_t, kCommandTableSize> table{};
+    for (auto& slot : table) {
+        slot = kCommandEmpty;
+    }
+    for (size_t i = 0; i < kCommandCount; ++i) {
+        table[commandHash(kCommandSpecs[i].name, kCommandSeed)] = static_cast<uint8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, kCommandTableSize> kCommandTable = buildCommandTable();
+
+// 按命令名查找命令编号（不区分大小写），未知命令返回 kCmdUnknown
+inline CommandId lookupCommand(std::string_view name) {
+    if (name.empty() || name.size() > kCommandMaxLength) {
+        return kCmdUnknown;
+    }
+    uint8_t index = kCommandTable[commandHash(name, kCommandSeed)];
+    if (index == kCommandEmpty) {
+        return kCmdUnknown;
+    }
+    const CommandSpec& spec = kCommandSpecs[index];
+    if (spec.name.size() != name.size()) {
+        return kCmdUnknown;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (toLowerAscii(name[i]) != spec.name[i]) {
+            return kCmdUnknown;
+        }
+    }
+    return spec.id;
+}
+
+#endif
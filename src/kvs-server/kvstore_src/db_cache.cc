@@ -0,0 +1,166 @@
+#include "db_cache.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "db_pool.h"
+#include "command_handler.h"
+#include "muduo/base/Logging.h"
+
+namespace {
+
+const size_t kDbWorkers = 4;  // 与 reactor 线程池的线程数相同
+
+thread_local bool t_async = false;
+thread_local bool t_deferred = false;
+
+// DB 线程池：每个线程一个任务队列，按键的哈希选择队列，同一个键的写穿透按提交顺序执行
+class DbWorkers {
+public:
+    DbWorkers() {
+        for (size_t i = 0; i < kDbWorkers; ++i) {
+            queues_.emplace_back(new Queue);
+            Queue* queue = queues_.back().get();
+            std::thread([queue]() { run(queue); }).detach();
+        }
+    }
+
+    void submit(std::string_view key, std::function<void()> task) {
+        Queue* queue = queues_[std::hash<std::string_view>()(key) % queues_.size()].get();
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->tasks.push_back(std::move(task));
+        }
+        queue->cv.notify_one();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static void run(Queue* queue) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue->mutex);
+                queue->cv.wait(lock, [queue]() { return !queue->tasks.empty(); });
+                task = std::move(queue->tasks.front());
+                queue->tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+};
+
+// 线程随进程退出，不析构
+DbWorkers& dbWorkers() {
+    static DbWorkers* workers = new DbWorkers;
+    return *workers;
+}
+
+// 按连接的字符集转义后加上单引号，键值中的引号、反斜杠和 NUL 都不会改变 SQL 语义
+std::string quoteSql(CDBConn* db_conn, std::string_view str) {
+    std::string escaped(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(db_conn->GetMysql(), &escaped[0], str.data(),
+                                                 static_cast<unsigned long>(str.size()));
+    escaped.resize(len);
+    return "'" + escaped + "'";
+}
+
+bool loadRow(std::string_view key, std::string* value) {
+    CDBManager *db_manager = CDBManager::getInstance();
+    CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
+    AUTO_REL_DBCONN(db_manager, db_conn);
+    if (!db_conn) {
+        LOG_ERROR << "get db conn failed";
+        return false;
+    }
+    std::string str_sql = "select number from student where name = " + quoteSql(db_conn, key);
+    std::unique_ptr<CResultSet> result_set(db_conn->ExecuteQuery(str_sql.c_str()));
+    if (result_set && result_set->Next()) {  // 确保有数据行
+        *value = result_set->GetString("number");
+        return true;
+    }
+    return false;
+}
+
+void insertRow(std::string_view key, std::string_view value) {
+    // 存储映射关系到 MySQL
+    CDBManager *db_manager = CDBManager::getInstance();
+    CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
+    AUTO_REL_DBCONN(db_manager, db_conn);
+    if (!db_conn) {
+        LOG_ERROR << "get db conn failed";
+        return;
+    }
+    std::string str_sql = "insert into student (name, number) values (" + quoteSql(db_conn, key) + ", " +
+                          quoteSql(db_conn, value) + ")";
+    LOG_DEBUG << "执行：" << str_sql;
+    if (!db_conn->ExecuteCreate(str_sql.c_str())) {
+        LOG_ERROR << str_sql << " 操作失败";
+    }
+}
+
+void deleteRow(std::string_view key) {
+    CDBManager *db_manager = CDBManager::getInstance();
+    CDBConn *db_conn = db_manager->GetDBConn("tuchuang_master");
+    AUTO_REL_DBCONN(db_manager, db_conn);
+    if (!db_conn) {
+        LOG_ERROR << "get db conn failed";
+        return;
+    }
+    // DELETE 没有结果集，不能走 ExecuteQuery；键不在库中时影响 0 行不算失败
+    std::string str_sql = "delete from student where name = " + quoteSql(db_conn, key);
+    db_conn->ExecuteUpdate(str_sql.c_str(), false);
+}
+
+}  // namespace
+
+bool dbCacheLoad(std::string_view key, std::string* value) {
+    if (t_async) {
+        t_deferred = true;
+        return false;
+    }
+    return loadRow(key, value);
+}
+
+void dbCacheInsert(std::string_view key, std::string_view value) {
+    if (t_async) {
+        dbCacheSubmit(key, [k = std::string(key), v = std::string(value)]() { insertRow(k, v); });
+        return;
+    }
+    insertRow(key, value);
+}
+
+void dbCacheDelete(std::string_view key) {
+    if (t_async) {
+        dbCacheSubmit(key, [k = std::string(key)]() { deleteRow(k); });
+        return;
+    }
+    deleteRow(key);
+}
+
+void dbCacheSetAsync(bool async) {
+    t_async = async;
+}
+
+bool dbCacheDeferred() {
+    return t_deferred;
+}
+
+bool dbCacheTakeDeferred() {
+    bool deferred = t_deferred;
+    t_deferred = false;
+    return deferred;
+}
+
+void dbCacheSubmit(std::string_view key, std::function<void()> task) {
+    dbWorkers().submit(key, std::move(task));
+}
@@ -0,0 +1,33 @@
+#ifndef DB_CACHE_H
+#define DB_CACHE_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// KV 缓存与 MySQL student 表的同步：
+// 缓存未命中时回源读取（读穿透），新键写入和删除时同步到数据库（写穿透）。
+// 单独成一个编译单元，协议层和基准测试不直接依赖 MySQL。
+//
+// 事件循环线程（multi_reactor 的 loop、proactor 的 ring）上同步访问 MySQL 会卡住该线程上的所有连接，
+// 这些线程调用 dbCacheSetAsync(true) 之后：
+//   - 写穿透复制参数后提交到 DB 线程池执行，不等待结果；
+//   - 读穿透不访问数据库，dbCacheLoad 直接返回 false 并记下 deferred 标记，协议层据此撤销这条请求
+//     已写出的响应并把它留在输入缓冲区，由服务器交给 DB 线程池重新执行（见 handleInput）。
+
+// 从数据库读取 key 对应的值，找到时写入 value 并返回 true
+bool dbCacheLoad(std::string_view key, std::string* value);
+// 插入新键的映射
+void dbCacheInsert(std::string_view key, std::string_view value);
+// 删除键的映射
+void dbCacheDelete(std::string_view key);
+
+// 设置当前线程是否异步访问数据库
+void dbCacheSetAsync(bool async);
+// 当前线程上有读穿透因为异步模式被推迟；dbCacheTakeDeferred 同时清除标记
+bool dbCacheDeferred();
+bool dbCacheTakeDeferred();
+// 在 DB 线程池中执行 task，key 相同的任务由同一个线程按提交顺序执行
+void dbCacheSubmit(std::string_view key, std::function<void()> task);
+
+#endif
@@ -0,0 +1,386 @@
+#include "eviction_policy.h"
+
+// ---------------- CLOCK ----------------
+
+void ClockPolicy::onInsert(uint32_t slot, EvictionMeta& meta) {
+    // 新键不带访问位：只被写入一次的键会先于被读过的热键淘汰
+    meta.recency.store(0, std::memory_order_relaxed);
+}
+
+void ClockPolicy::onAccess(uint32_t slot, EvictionMeta& meta) {
+    // 已置位时不再写，减少多个读者对同一缓存行的争用
+    if (meta.recency.load(std::memory_order_relaxed) == 0) {
+        meta.recency.store(1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t ClockPolicy::selectVictim(EvictionTable& table) {
+    uint32_t count = table.slotCount();
+    uint32_t victim = UINT32_MAX;
+    size_t victim_charge = 0;
+    int cold = 0;
+    // 最多转两圈：第一圈清掉所有访问位，第二圈必然命中
+    for (uint64_t step = 0; step < 2ULL * count; ++step) {
+        if (hand_ >= count) {
+            hand_ = 0;
+        }
+        EvictionMeta& meta = table.slotMeta(hand_);
+        if (meta.recency.exchange(0, std::memory_order_relaxed) == 0) {
+            if (!size_aware_) {
+                // 不推进指针：该槽位会被最后一个槽位填充，下一轮正好检查它
+                return hand_;
+            }
+            size_t charge = table.slotCharge(hand_);
+            if (victim == UINT32_MAX || charge > victim_charge) {
+                victim = hand_;
+                victim_charge = charge;
+            }
+            if (++cold >= kSizeCandidates) {
+                break;
+            }
+        }
+        ++hand_;
+    }
+    if (victim != UINT32_MAX) {
+        // 跳过的冷槽位访问位已清零，下一次淘汰从被填充的 victim 处继续
+        hand_ = victim;
+        return victim;
+    }
+    if (hand_ >= count) {
+        hand_ = 0;
+    }
+    return hand_;
+}
+
+// ---------------- 采样 LRU ----------------
+
+SampledLruPolicy::SampledLruPolicy(size_t samples)
+    : samples_(samples == 0 ? 1 : samples),
+      rng_state_(reinterpret_cast<uintptr_t>(this) | 1) {}
+
+void SampledLruPolicy::onInsert(uint32_t slot, EvictionMeta& meta) {
+    uint32_t now = clock_.fetch_add(1, std::memory_order_relaxed) + 1;
+    meta.recency.store(now, std::memory_order_relaxed);
+}
+
+void SampledLruPolicy::onAccess(uint32_t slot, EvictionMeta& meta) {
+    uint32_t now = clock_.load(std::memory_order_relaxed);
+    if (meta.recency.load(std::memory_order_relaxed) != now) {
+        meta.recency.store(now, std::memory_order_relaxed);
+    }
+}
+
+uint32_t SampledLruPolicy::selectVictim(EvictionTable& table) {
+    uint32_t count = table.slotCount();
+    uint32_t now = clock_.load(std::memory_order_relaxed);
+    uint32_t victim = 0;
+    uint64_t best_score = 0;
+    for (size_t i = 0; i < samples_; ++i) {
+        uint32_t slot = nextRandom() % count;
+        // 无符号减法天然处理时钟回绕
+        uint64_t score = now - table.slotMeta(slot).recency.load(std::memory_order_relaxed);
+        if (size_aware_) {
+            score = (score + 1) * table.slotCharge(slot);
+        }
+        if (i == 0 || score > best_score) {
+            victim = slot;
+            best_score = score;
+        }
+    }
+    return victim;
+}
+
+uint32_t SampledLruPolicy::nextRandom() {
+    // xorshift64*，只在独占锁内调用
+    rng_state_ ^= rng_state_ >> 12;
+    rng_state_ ^= rng_state_ << 25;
+    rng_state_ ^= rng_state_ >> 27;
+    return static_cast<uint32_t>((rng_state_ * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// ---------------- 频率草图 ----------------
+
+namespace {
+const uint64_t kSketchSeeds[4] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+    0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+const uint64_t kResetMask = 0x7777777777777777ULL;
+}
+
+void FrequencySketch::ensureCapacity(size_t capacity) {
+    size_t width = 16;
+    while (width < capacity) {
+        width <<= 1;
+    }
+    if (width <= table_.size()) {
+        return;
+    }
+    // 扩容时保留已有计数：新表下标 j 的低位就是旧表下标，复制 old[j & old_mask]
+    // 后每个键在各行读到的计数不变，频率估计延续下去，不会随键数翻倍而清零
+    std::vector<uint64_t> table(width, 0);
+    if (!table_.empty()) {
+        for (size_t i = 0; i < width; ++i) {
+            table[i] = table_[i & mask_];
+        }
+    }
+    table_.swap(table);
+    mask_ = width - 1;
+    sample_size_ = 10 * width;
+}
+
+size_t FrequencySketch::indexOf(uint64_t hash, int depth) const {
+    uint64_t h = (hash + kSketchSeeds[depth]) * kSketchSeeds[depth];
+    h += h >> 32;
+    return static_cast<size_t>(h & mask_);
+}
+
+void FrequencySketch::increment(uint64_t hash) {
+    if (table_.empty()) {
+        return;
+    }
+    // 每个字的 16 个计数分成 4 组，第 i 行使用第 i 组
+    int start = static_cast<int>((hash & 3) << 2);
+    bool added = false;
+    for (int i = 0; i < 4; ++i) {
+        uint64_t& word = table_[indexOf(hash, i)];
+        int offset = (start + i) << 2;
+        uint64_t mask = 0xfULL << offset;
+        if ((word & mask) != mask) {
+            word += 1ULL << offset;
+            added = true;
+        }
+    }
+    if (added && ++additions_ >= sample_size_) {
+        reset();
+    }
+}
+
+uint32_t FrequencySketch::frequency(uint64_t hash) const {
+    if (table_.empty()) {
+        return 0;
+    }
+    int start = static_cast<int>((hash & 3) << 2);
+    uint32_t freq = 15;
+    for (int i = 0; i < 4; ++i) {
+        int offset = (start + i) << 2;
+        uint32_t count = static_cast<uint32_t>((table_[indexOf(hash, i)] >> offset) & 0xf);
+        if (count < freq) {
+            freq = count;
+        }
+    }
+    return freq;
+}
+
+void FrequencySketch::reset() {
+    for (auto& word : table_) {
+        word = (word >> 1) & kResetMask;
+    }
+    additions_ /= 2;
+}
+
+// ---------------- W-TinyLFU ----------------
+
+void WTinyLfuPolicy::setLimits(size_t max_keys, size_t max_memory) {
+    max_keys_ = max_keys;
+    size_aware_ = max_memory > 0;
+    resize(max_keys > 0 ? max_keys : prev_.size());
+}
+
+void WTinyLfuPolicy::resize(size_t capacity) {
+    // 窗口占 1%，主区中保护段占 80%
+    window_max_ = capacity / 100 > 0 ? capacity / 100 : 1;
+    size_t main_max = capacity > window_max_ ? capacity - window_max_ : 1;
+    protected_max_ = main_max * 4 / 5 > 0 ? main_max * 4 / 5 : 1;
+    sketch_.ensureCapacity(capacity);
+}
+
+void WTinyLfuPolicy::onInsert(uint32_t slot, EvictionMeta& meta) {
+    drainReadBuffer();
+    if (slot >= prev_.size()) {
+        size_t size = static_cast<size_t>(slot) + 1;
+        prev_.resize(size, kNil);
+        next_.resize(size, kNil);
+        segment_.resize(size, kWindow);
+        hash_.resize(size, 0);
+        // 只按内存限制时键数不固定，随键数翻倍重新估算各段大小
+        if (max_keys_ == 0 && (size & (size - 1)) == 0) {
+            resize(size * 2);
+        }
+    }
+    hash_[slot] = table_ ? table_->slotHash(slot) : slot;
+    sketch_.increment(hash_[slot]);
+    pushFront(kWindow, slot);
+
+    // 窗口超限时尾部进入试用段，成为下一次淘汰时的准入候选
+    while (lists_[kWindow].size > window_max_) {
+        uint32_t overflow = lists_[kWindow].tail;
+        unlink(overflow);
+        pushFront(kProbation, overflow);
+        candidate_ = overflow;
+    }
+}
+
+void WTinyLfuPolicy::onAccess(uint32_t slot, EvictionMeta& meta) {
+    if (read_count_.load(std::memory_order_relaxed) >= kReadBufferSize) {
+        return;
+    }
+    uint32_t index = read_count_.fetch_add(1, std::memory_order_relaxed);
+    if (index < kReadBufferSize) {
+        read_buffer_[index].store(slot, std::memory_order_relaxed);
+    }
+}
+
+void WTinyLfuPolicy::onRemove(uint32_t slot) {
+    // 回放必须在槽位变化之前完成，保证缓冲中的下标仍然有效
+    drainReadBuffer();
+    unlink(slot);
+    if (candidate_ == slot) {
+        candidate_ = kNil;
+    }
+}
+
+void WTinyLfuPolicy::onMove(uint32_t from, uint32_t to) {
+    uint32_t prev = prev_[from];
+    uint32_t next = next_[from];
+    Segment segment = static_cast<Segment>(segment_[from]);
+    prev_[to] = prev;
+    next_[to] = next;
+    segment_[to] = segment;
+    hash_[to] = hash_[from];
+    if (prev != kNil) {
+        next_[prev] = to;
+    } else {
+        lists_[segment].head = to;
+    }
+    if (next != kNil) {
+        prev_[next] = to;
+    } else {
+        lists_[segment].tail = to;
+    }
+    prev_[from] = next_[from] = kNil;
+    if (candidate_ == from) {
+        candidate_ = to;
+    }
+}
+
+uint32_t WTinyLfuPolicy::selectVictim(EvictionTable& table) {
+    drainReadBuffer();
+
+    // 主区为空时只能从窗口淘汰
+    uint32_t victim = probationVictim();
+    if (victim == kNil) {
+        victim = lists_[kProtected].tail;
+    }
+    if (victim == kNil) {
+        return lists_[kWindow].tail;
+    }
+
+    // 刚从窗口进入试用段的候选与试用段尾部比较频率，频率不高于对方则拒绝准入
+    uint32_t candidate = candidate_;
+    candidate_ = kNil;
+    if (candidate == kNil || candidate == victim || segment_[candidate] != kProbation) {
+        return victim;
+    }
+    return lessValuable(victim, candidate) ? victim : candidate;
+}
+
+// 试用段尾部即淘汰对象；按内存限制时在尾部几个键中选“频率 / 占用内存”最低的
+uint32_t WTinyLfuPolicy::probationVictim() {
+    uint32_t victim = lists_[kProbation].tail;
+    if (!size_aware_ || victim == kNil || table_ == nullptr) {
+        return victim;
+    }
+    uint32_t slot = prev_[victim];
+    for (int i = 1; i < kSizeCandidates && slot != kNil; ++i, slot = prev_[slot]) {
+        if (lessValuable(slot, victim)) {
+            victim = slot;
+        }
+    }
+    return victim;
+}
+
+// a 比 b 更应该被淘汰：频率更低；按内存限制时比较 (频率 + 1) / 占用内存，交叉相乘避免除法
+bool WTinyLfuPolicy::lessValuable(uint32_t a, uint32_t b) const {
+    uint64_t freq_a = sketch_.frequency(hash_[a]);
+    uint64_t freq_b = sketch_.frequency(hash_[b]);
+    if (!size_aware_ || table_ == nullptr) {
+        return freq_a < freq_b;
+    }
+    return (freq_a + 1) * table_->slotCharge(b) < (freq_b + 1) * table_->slotCharge(a);
+}
+
+void WTinyLfuPolicy::drainReadBuffer() {
+    uint32_t count = read_count_.load(std::memory_order_relaxed);
+    if (count > kReadBufferSize) {
+        count = kReadBufferSize;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t slot = read_buffer_[i].load(std::memory_order_relaxed);
+        if (slot < prev_.size()) {
+            sketch_.increment(hash_[slot]);
+            onHit(slot);
+        }
+    }
+    read_count_.store(0, std::memory_order_relaxed);
+}
+
+void WTinyLfuPolicy::onHit(uint32_t slot) {
+    Segment segment = static_cast<Segment>(segment_[slot]);
+    unlink(slot);
+    if (segment == kWindow) {
+        pushFront(kWindow, slot);
+        return;
+    }
+    // 试用段命中晋升到保护段，保护段超限时尾部降级回试用段
+    pushFront(kProtected, slot);
+    if (lists_[kProtected].size > protected_max_) {
+        uint32_t demoted = lists_[kProtected].tail;
+        unlink(demoted);
+        pushFront(kProbation, demoted);
+    }
+}
+
+void WTinyLfuPolicy::pushFront(Segment segment, uint32_t slot) {
+    List& list = lists_[segment];
+    segment_[slot] = segment;
+    prev_[slot] = kNil;
+    next_[slot] = list.head;
+    if (list.head != kNil) {
+        prev_[list.head] = slot;
+    } else {
+        list.tail = slot;
+    }
+    list.head = slot;
+    ++list.size;
+}
+
+void WTinyLfuPolicy::unlink(uint32_t slot) {
+    List& list = lists_[segment_[slot]];
+    uint32_t prev = prev_[slot];
+    uint32_t next = next_[slot];
+    if (prev != kNil) {
+        next_[prev] = next;
+    } else {
+        list.head = next;
+    }
+    if (next != kNil) {
+        prev_[next] = prev;
+    } else {
+        list.tail = prev;
+    }
+    prev_[slot] = next_[slot] = kNil;
+    --list.size;
+}
+
+std::unique_ptr<EvictionPolicy> createEvictionPolicy(const std::string& name, size_t samples) {
+    if (name == "clock") {
+        return std::unique_ptr<EvictionPolicy>(new ClockPolicy());
+    }
+    if (name == "sampled_lru") {
+        return std::unique_ptr<EvictionPolicy>(new SampledLruPolicy(samples));
+    }
+    if (name == "wtinylfu") {
+        return std::unique_ptr<EvictionPolicy>(new WTinyLfuPolicy());
+    }
+    return nullptr;
+}
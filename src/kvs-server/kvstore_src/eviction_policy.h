@@ -0,0 +1,170 @@
+#ifndef EVICTION_POLICY_H
+#define EVICTION_POLICY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 淘汰策略使用的元数据，直接嵌在每个 Entry 中，不再额外分配链表节点
+struct EvictionMeta {
+    // CLOCK：访问位；采样 LRU：最近一次访问时的逻辑时钟
+    std::atomic<uint32_t> recency{0};
+
+    EvictionMeta() = default;
+    // 槽位搬动只发生在独占锁内，拷贝时没有并发读者
+    EvictionMeta(const EvictionMeta& other)
+        : recency(other.recency.load(std::memory_order_relaxed)) {}
+    EvictionMeta& operator=(const EvictionMeta& other) {
+        recency.store(other.recency.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+};
+
+// 分片向淘汰策略暴露的槽位视图，槽位下标连续，范围 [0, slotCount())
+class EvictionTable {
+public:
+    virtual ~EvictionTable() = default;
+    virtual uint32_t slotCount() const = 0;
+    virtual EvictionMeta& slotMeta(uint32_t slot) = 0;
+    virtual uint64_t slotHash(uint32_t slot) = 0;
+    // 槽位占用的估算内存（字节）
+    virtual size_t slotCharge(uint32_t slot) = 0;
+};
+
+// 可插拔的淘汰策略接口
+// 除 onAccess 外，所有回调都在分片独占锁内调用；
+// onAccess 在共享锁内被多个读线程并发调用，实现只能使用原子操作。
+// 删除槽位时分片先调用 onRemove(slot)，再把最后一个槽位搬到 slot 并调用 onMove(last, slot)。
+class EvictionPolicy {
+public:
+    virtual ~EvictionPolicy() = default;
+
+    virtual const char* name() const = 0;
+    // 绑定所属分片的槽位视图，分片更换策略时调用
+    virtual void attach(EvictionTable* table) {}
+    // 分片限制变化时调用：max_keys 为键数上限，max_memory 为内存上限，0 表示不限制
+    virtual void setLimits(size_t max_keys, size_t max_memory) {}
+    virtual void onInsert(uint32_t slot, EvictionMeta& meta) = 0;
+    virtual void onAccess(uint32_t slot, EvictionMeta& meta) = 0;
+    virtual void onRemove(uint32_t slot) {}
+    virtual void onMove(uint32_t from, uint32_t to) {}
+    // 选出一个淘汰槽位，调用前保证 table.slotCount() > 0
+    virtual uint32_t selectVictim(EvictionTable& table) = 0;
+};
+
+// CLOCK（二次机会）：槽位数组即时钟环，命中只置访问位；
+// 按内存限制时指针继续扫过几个没有访问位的槽位，淘汰其中占用内存最大的
+class ClockPolicy : public EvictionPolicy {
+public:
+    const char* name() const override { return "clock"; }
+    void setLimits(size_t max_keys, size_t max_memory) override { size_aware_ = max_memory > 0; }
+    void onInsert(uint32_t slot, EvictionMeta& meta) override;
+    void onAccess(uint32_t slot, EvictionMeta& meta) override;
+    uint32_t selectVictim(EvictionTable& table) override;
+
+private:
+    static constexpr int kSizeCandidates = 4;  // 按内存限制时比较的冷槽位数
+
+    uint32_t hand_ = 0;
+    bool size_aware_ = false;
+};
+
+// Redis 风格的采样近似 LRU：随机采样若干槽位，淘汰最久未访问的；
+// 按内存限制时用“空闲时长 × 占用内存”打分，优先淘汰又大又冷的键
+class SampledLruPolicy : public EvictionPolicy {
+public:
+    explicit SampledLruPolicy(size_t samples);
+
+    const char* name() const override { return "sampled_lru"; }
+    void setLimits(size_t max_keys, size_t max_memory) override { size_aware_ = max_memory > 0; }
+    void onInsert(uint32_t slot, EvictionMeta& meta) override;
+    void onAccess(uint32_t slot, EvictionMeta& meta) override;
+    uint32_t selectVictim(EvictionTable& table) override;
+
+private:
+    uint32_t nextRandom();
+
+    size_t samples_;
+    bool size_aware_ = false;
+    // 逻辑时钟，只在独占锁内推进，读者 relaxed 读取
+    std::atomic<uint32_t> clock_{1};
+    uint64_t rng_state_;
+};
+
+// 4 bit 计数的 Count-Min Sketch，累计增加次数达到采样窗口后所有计数减半（老化）
+class FrequencySketch {
+public:
+    void ensureCapacity(size_t capacity);
+    void increment(uint64_t hash);
+    uint32_t frequency(uint64_t hash) const;
+
+private:
+    size_t indexOf(uint64_t hash, int depth) const;
+    void reset();
+
+    std::vector<uint64_t> table_; // 每个 64 位字存 16 个 4 bit 计数
+    uint64_t mask_ = 0;
+    size_t sample_size_ = 0;
+    size_t additions_ = 0;
+};
+
+// W-TinyLFU：新键先进入 1% 容量的窗口 LRU，被挤出窗口后与主区（分段 LRU：
+// 试用段 + 保护段）的淘汰候选比较访问频率，频率低者被淘汰，防止一次性扫描冲掉热键。
+// 链表以槽位下标串联；读命中只写入无锁读缓冲，在下一次独占锁回调时统一回放。
+// 按内存限制时比较的是“频率 / 占用内存”：试用段尾部几个键中选最低的作为淘汰对象，
+// 准入时大而少用的候选不会挤掉小而常用的键。
+class WTinyLfuPolicy : public EvictionPolicy {
+public:
+    const char* name() const override { return "wtinylfu"; }
+    void attach(EvictionTable* table) override { table_ = table; }
+    void setLimits(size_t max_keys, size_t max_memory) override;
+    void onInsert(uint32_t slot, EvictionMeta& meta) override;
+    void onAccess(uint32_t slot, EvictionMeta& meta) override;
+    void onRemove(uint32_t slot) override;
+    void onMove(uint32_t from, uint32_t to) override;
+    uint32_t selectVictim(EvictionTable& table) override;
+
+private:
+    enum Segment : uint8_t { kWindow = 0, kProbation = 1, kProtected = 2 };
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint32_t kReadBufferSize = 256;
+    static constexpr int kSizeCandidates = 4;  // 按内存限制时比较的试用段尾部键数
+
+    struct List {
+        uint32_t head = kNil;
+        uint32_t tail = kNil;
+        size_t size = 0;
+    };
+
+    void drainReadBuffer();
+    void onHit(uint32_t slot);
+    void pushFront(Segment segment, uint32_t slot);
+    void unlink(uint32_t slot);
+    void resize(size_t capacity);
+    uint32_t probationVictim();
+    bool lessValuable(uint32_t a, uint32_t b) const;
+
+    EvictionTable* table_ = nullptr;
+    FrequencySketch sketch_;
+    List lists_[3];
+    std::vector<uint32_t> prev_;
+    std::vector<uint32_t> next_;
+    std::vector<uint8_t> segment_;
+    std::vector<uint64_t> hash_;
+    size_t max_keys_ = 0;       // 0 表示按当前键数动态估算各段大小
+    bool size_aware_ = false;   // 设置了内存上限
+    size_t window_max_ = 1;
+    size_t protected_max_ = 1;
+    uint32_t candidate_ = kNil; // 最近一个被挤出窗口的槽位
+
+    // 读缓冲：共享锁内多个读者并发写入，满了直接丢弃（只影响近似精度）
+    std::atomic<uint32_t> read_count_{0};
+    std::atomic<uint32_t> read_buffer_[kReadBufferSize];
+};
+
+// 根据名称创建淘汰策略，支持 clock / sampled_lru / wtinylfu，未知名称返回 nullptr
+std::unique_ptr<EvictionPolicy> createEvictionPolicy(const std::string& name, size_t samples = 5);
+
+#endif
@@ -1,7 +1,12 @@
+#ifndef KVSTORE_H
+#define KVSTORE_H
+
+#include <algorithm>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <mutex>
-#include <list>
+#include <shared_mutex>
+#include <atomic>
 #include <iostream>
 #include <chrono>
 #include <fstream>
@@ -10,9 +15,32 @@
 #include <thread>
 #include <functional>
 #include <condition_variable>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include "eviction_policy.h"
+#include "slot_array.h"
+#include "swiss_table.h"
+#include "timing_wheel.h"
+#include "coarse_clock.h"
+#include "snapshot.h"
+#include "wal.h"
 
 using std::string;
 
+// 大 value 的共享存储：超过阈值的值按引用计数保存，零拷贝发送时持有一份引用，
+// 覆盖或删除键不会释放内核还在发送的数据
+using SharedValue = std::shared_ptr<const std::string>;
+
+// 以 sink(value, owner) 或 sink(value) 调用读取回调；owner 为 value 的共享存储，内联保存的值为空
+template <typename Sink>
+void invokeValueSink(Sink& sink, std::string_view value, const SharedValue& owner) {
+    if constexpr (std::is_invocable_v<Sink&, std::string_view, const SharedValue&>) {
+        sink(value, owner);
+    } else {
+        sink(value);
+    }
+}
 
 struct GetResult {
     bool exists = false;    // 键是否存在（未被删除）
@@ -25,93 +53,699 @@ struct SetResult {
     bool evicted = false;     // 是否因容量限制淘汰了旧键
 };
 
+struct ExpireSample {
+    size_t sampled = 0;  // 采样到的带 TTL 的键数
+    size_t expired = 0;  // 其中已过期并被删除的键数
+};
 
-//kv存储系统
-class KVStore {
+// 快照加载统计
+struct LoadStats {
+    uint64_t keys = 0;        // 载入的键数（不含已过期的）
+    uint64_t bytes = 0;       // 快照文件字节数
+    size_t threads = 0;       // 并行加载的线程数
+    uint64_t elapsed_ms = 0;
+};
+
+// 快照统计，通过 RESP 的 INFO 命令查看
+struct SnapshotStats {
+    bool in_progress = false;
+    uint64_t snapshots = 0;          // 成功写出的快照数
+    uint64_t failures = 0;           // 失败次数
+    bool last_ok = true;             // 最近一次是否成功
+    int64_t last_time = 0;           // 最近一次完成的墙上时间（秒）
+    uint64_t last_duration_ms = 0;   // 最近一次的耗时
+    uint64_t last_bytes = 0;         // 最近一次写出的文件字节数
+    uint64_t last_keys = 0;          // 最近一次写出的键数
+    uint64_t last_cow_entries = 0;   // 最近一次快照期间写入者为快照保留旧版本的键数
+};
+
+
+// 单个分片：拥有独立的锁、哈希索引、淘汰策略、容量份额和过期清理
+// 读路径只持有共享锁，命中时只通过淘汰策略更新 Entry 内的原子元数据。
+// 键值按槽位稠密存放在 entries_ 中（短键短值由 SSO 内联），index_ 是 Swiss table
+// 风格的开放寻址索引，只保存 hash -> 槽位下标；淘汰策略直接按槽位下标工作。
+// 设置了 TTL 的槽位同时挂在分层时间轮 wheel_ 上，过期清理只处理到期的键。
+class KVShard : private EvictionTable {
 public:
-    static KVStore& getInstance() { //单例模式
-        static KVStore instance;
-        return instance;
+    struct Entry {
+        std::string key;
+        std::string value;    // 小于共享阈值的值内联保存
+        SharedValue shared;   // 达到共享阈值的值，此时 value 为空
+        uint64_t expire_ms = 0; // 过期时刻（CoarseClock 毫秒），kNoExpire 表示不过期
+        uint64_t hash = 0;    // 完整哈希，索引扩容和淘汰策略使用，避免重新计算
+        uint32_t charge = 0;  // 估算占用的内存（字节）
+        EvictionMeta meta;    // 淘汰策略的元数据
+        uint32_t snapshot_epoch = 0;  // 等于分片当前快照编号时表示已写入快照或不属于快照
+
+        std::string_view view() const { return shared ? std::string_view(*shared) : std::string_view(value); }
+    };
+
+    static constexpr int64_t kDefaultExpireTickMs = 100;
+    static constexpr uint64_t kNoExpire = UINT64_MAX;
+    static constexpr size_t kSharedValueOverhead = 64;  // make_shared 控制块 + std::string 对象，按分配器粒度取整
+
+    explicit KVShard(size_t capacity, size_t max_memory = 0)
+        : index_([this](uint32_t slot) { return entries_[slot].hash; }),
+          wheel_(nowTick(kDefaultExpireTickMs)),
+          max_capacity_(capacity), max_memory_(max_memory), policy_(new ClockPolicy()) {
+        policy_->attach(this);
+        policy_->setLimits(max_capacity_, max_memory_);
     }
 
-    KVStore(const KVStore&) = delete;
-    KVStore& operator=(const KVStore&) = delete;
+    KVShard(const KVShard&) = delete;
+    KVShard& operator=(const KVShard&) = delete;
 
-    // 设置缓存最大容量
+    // 键数上限，0 表示不限制
     void setMaxCapacity(size_t capacity) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
         max_capacity_ = capacity;
+        policy_->setLimits(max_capacity_, max_memory_);
+        evictIfNeeded();
     }
 
-    GetResult get(const string& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        GetResult result;
-        auto it = store_.find(key);
-        if (it == store_.end()) {
-            result.exists = false;
-            return result;
+    // 内存上限（字节），0 表示不限制
+    void setMaxMemory(size_t max_memory) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        max_memory_ = max_memory;
+        policy_->setLimits(max_capacity_, max_memory_);
+        evictIfNeeded();
+    }
+
+    // 更换淘汰策略，已有的键按插入处理
+    void setEvictionPolicy(std::unique_ptr<EvictionPolicy> policy) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        policy_ = std::move(policy);
+        policy_->attach(this);
+        policy_->setLimits(max_capacity_, max_memory_);
+        for (uint32_t i = 0; i < entries_.size(); ++i) {
+            policy_->onInsert(i, entries_[i].meta);
         }
+    }
 
-        auto now = std::chrono::system_clock::now();
-        if (now > it->second.expire_time) {
-            // 键存在但已过期，删除并标记状态
-            access_order_.erase(it->second.it);
-            store_.erase(it);
-            result.exists = true;
-            result.expired = true;
-            return result;
+    // 不小于 bytes 的值按引用计数保存（SharedValue），0 表示全部内联保存；只影响之后写入的值
+    void setSharedValueThreshold(size_t bytes) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        shared_value_bytes_ = bytes;
+    }
+
+    // 时间轮的 tick 精度（毫秒），已有的过期时间按新精度重新挂到时间轮上
+    void setExpireTick(std::chrono::milliseconds tick) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        expire_tick_ms_ = tick.count() > 0 ? tick.count() : 1;
+        wheel_ = TimingWheel(nowTick(expire_tick_ms_));
+        for (uint32_t slot = 0; slot < entries_.size(); ++slot) {
+            scheduleExpiry(slot);
         }
+    }
 
-        // 键存在且未过期，更新访问顺序
-        access_order_.erase(it->second.it);
-        access_order_.push_front(key);
-        it->second.it = access_order_.begin();
+    GetResult get(std::string_view key, uint64_t hash) {
+        std::string value;
+        GetResult result = getWith(key, hash, [&value](std::string_view v) { value.assign(v.data(), v.size()); });
+        result.value = std::move(value);
+        return result;
+    }
+
+    // 命中时在锁内以 string_view 调用 sink(value)，由调用方直接编码到输出缓冲区，不拷贝值；
+    // sink 也可以接受 (value, owner)，owner 非空时调用方可以持有引用在锁外零拷贝发送。
+    // 返回结果中的 value 始终为空
+    template <typename Sink>
+    GetResult getWith(std::string_view key, uint64_t hash, Sink&& sink) {
+        GetResult result;
+        uint64_t now = CoarseClock::nowMs();
+        {
+            // 命中路径只持有共享锁，多个读者可以并发
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            uint32_t slot = find(key, hash);
+            if (slot == SwissIndex::kNotFound) {
+                result.exists = false;
+                return result;
+            }
+            Entry& entry = entries_[slot];
+            if (now <= entry.expire_ms) {
+                // 键存在且未过期，只更新淘汰元数据
+                policy_->onAccess(slot, entry.meta);
+                result.exists = true;
+                result.expired = false;
+                invokeValueSink(sink, entry.view(), entry.shared);
+                return result;
+            }
+        }
 
+        // 键存在但已过期，升级为独占锁后重新检查再删除
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint32_t slot = find(key, hash);
+        if (slot != SwissIndex::kNotFound) {
+            Entry& entry = entries_[slot];
+            if (now <= entry.expire_ms) {
+                // 释放共享锁期间已被重新设置
+                policy_->onAccess(slot, entry.meta);
+                result.exists = true;
+                result.expired = false;
+                invokeValueSink(sink, entry.view(), entry.shared);
+                return result;
+            }
+            removeEntry(slot);
+        }
         result.exists = true;
-        result.expired = false;
-        result.value = it->second.value;
+        result.expired = true;
         return result;
     }
 
-    // 同步设置 key 并指定过期时间
-    SetResult set(const std::string& key, const std::string& value, std::chrono::seconds ttl = std::chrono::seconds(60)) {
-        std::cout << "set key: " << key << " value: " << value << " ttl: " << ttl.count() << std::endl;
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::cout << "set key1: " << key << " value: " << value << " ttl: " << ttl.count() << std::endl;
+    SetResult set(std::string_view key, uint64_t hash, std::string_view value, std::chrono::milliseconds ttl) {
+        SetResult result;
+        uint64_t lsn = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            lsn = setAndLogLocked(key, hash, value, ttl, &result);
+        }
+        if (lsn != 0) {
+            wal_->waitDurable(lsn);  // 释放锁后等待落盘（fsync 策略为 always 时）
+        }
+        return result;
+    }
+
+    // 回源数据库后填充缓存：回源期间键可能已被 SET，键存在且未过期时保留现有值，返回是否写入
+    bool fill(std::string_view key, uint64_t hash, std::string_view value, std::chrono::milliseconds ttl) {
         SetResult result;
-        auto expire_time = std::chrono::system_clock::now() + ttl;
-        if (ttl.count() == 0) {
-            expire_time = std::chrono::system_clock::time_point::max(); // 无过期时间
+        uint64_t lsn = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            uint32_t slot = find(key, hash);
+            if (slot != SwissIndex::kNotFound && CoarseClock::nowMs() <= entries_[slot].expire_ms) {
+                return false;
+            }
+            lsn = setAndLogLocked(key, hash, value, ttl, &result);
+        }
+        if (lsn != 0) {
+            wal_->waitDurable(lsn);
+        }
+        return true;
+    }
+
+    // 按绝对过期时刻设置 key（CoarseClock 毫秒，kNoExpire 表示不过期），加载持久化数据时使用
+    SetResult setExpireAt(std::string_view key, uint64_t hash, std::string_view value, uint64_t expire_ms) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return setLocked(key, hash, value, expire_ms);
+    }
+
+    bool del(std::string_view key, uint64_t hash) {
+        uint64_t lsn = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            uint32_t slot = find(key, hash);
+            if (slot == SwissIndex::kNotFound) {
+                return false;  // 未找到 key
+            }
+            removeEntry(slot);  // 从索引和槽位数组中删除
+            if (wal_) {
+                lsn = wal_->appendDel(key);
+            }
+        }
+        if (lsn != 0) {
+            wal_->waitDurable(lsn);
+        }
+        return true;  // 成功删除
+    }
+
+    // 删除 key，不写日志，回放日志时使用
+    bool remove(std::string_view key, uint64_t hash) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint32_t slot = find(key, hash);
+        if (slot == SwissIndex::kNotFound) {
+            return false;
+        }
+        removeEntry(slot);
+        return true;
+    }
+
+    // 之后的 set / del 追加到变更日志，nullptr 表示不记录；setExpireAt / insertBatch / remove 不记录
+    void setWriteAheadLog(WriteAheadLog* wal) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        wal_ = wal;
+    }
+
+    // 推进时间轮并删除到期的 key，最多删除 max_keys 个，剩下的留到下一次；返回删除的数量
+    size_t expireKeys(size_t max_keys) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint64_t now = CoarseClock::nowMs();
+        uint64_t now_tick = now / static_cast<uint64_t>(expire_tick_ms_);
+        size_t expired = 0;
+        while (expired < max_keys) {
+            uint32_t slot = wheel_.popExpired(now_tick);
+            if (slot == TimingWheel::kNil) {
+                break;
+            }
+            if (now > entries_[slot].expire_ms) {
+                removeEntry(slot);
+                ++expired;
+            } else {
+                // 到期时间落在当前 tick 内，下一个 tick 再检查
+                wheel_.schedule(slot, now_tick + 1);
+            }
+        }
+        return expired;
+    }
+
+    // Redis 风格的主动过期采样：随机检查最多 samples 个带 TTL 的键，删除其中已过期的
+    ExpireSample sampleExpired(size_t samples) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        ExpireSample result;
+        if (wheel_.size() == 0) {
+            return result;
         }
+        uint64_t now = CoarseClock::nowMs();
+        // 带 TTL 的键较少时随机槽位大多没有 TTL，限制总探测次数
+        for (size_t probes = 0; result.sampled < samples && probes < samples * 4 && !entries_.empty(); ++probes) {
+            uint32_t slot = static_cast<uint32_t>(nextRandom() % entries_.size());
+            if (!wheel_.scheduled(slot)) {
+                continue;
+            }
+            ++result.sampled;
+            if (now > entries_[slot].expire_ms) {
+                removeEntry(slot);
+                ++result.expired;
+            }
+        }
+        return result;
+    }
+
+    // 后台推进索引的渐进式扩容，每次最多迁移 groups 个组，返回是否仍在迁移
+    bool rehashStep(size_t groups) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            if (!index_.rehashing()) {
+                return false;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return index_.migrate(groups);
+    }
+
+    // 持有共享锁遍历本分片的所有键，逐个调用 fn(key, value, expire_ms)，用于写快照
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (size_t slot = 0; slot < entries_.size(); ++slot) {
+            const Entry& entry = entries_[slot];
+            fn(std::string_view(entry.key), entry.view(), entry.expire_ms);
+        }
+    }
+
+    // 批量写入的一条记录，expire_ms 为 CoarseClock 毫秒
+    struct BatchEntry {
+        std::string_view key;
+        std::string_view value;
+        uint64_t hash = 0;
+        uint64_t expire_ms = kNoExpire;
+    };
+
+    // 加载快照时按块批量写入，整批只加一次独占锁
+    void insertBatch(const BatchEntry* batch, size_t count) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (size_t i = 0; i < count; ++i) {
+            setLocked(batch[i].key, batch[i].hash, batch[i].value, batch[i].expire_ms);
+        }
+    }
+
+    // 快照中的一条记录：键值的拷贝（大值只持有共享存储的引用）
+    struct SnapshotEntry {
+        std::string key;
+        std::string value;
+        SharedValue shared;
+        uint64_t expire_ms = kNoExpire;
+
+        std::string_view view() const { return shared ? std::string_view(*shared) : std::string_view(value); }
+    };
+
+    // 按记录写时复制的快照：beginSnapshotLocked 记下时间点，之后快照线程用 snapshotChunk
+    // 每次在共享锁内从游标处拷出一小批还没写入快照的键，写盘时不持锁。快照进行中，写入者
+    // 覆盖或删除还没写入快照的键之前先把旧版本保存下来交给快照线程，新插入的键直接标记为不属于快照，
+    // 因此写出的是开始时刻的一致视图，写入者只在改动快照未覆盖的键时多一次拷贝。
+
+    // 调用方持有独占锁（KVStore 同时锁住所有分片，让各分片的时间点一致）
+    std::unique_lock<std::shared_mutex> exclusiveLock() { return std::unique_lock<std::shared_mutex>(mutex_); }
+
+    void beginSnapshotLocked(uint32_t epoch) {
+        snapshot_epoch_ = epoch;
+        snapshot_cursor_ = 0;
+        snapshot_saved_.clear();
+        snapshot_cow_entries_ = 0;
+    }
+
+    // 取出下一批快照记录追加到 out，最多约 max_entries 个键或 max_bytes 字节，
+    // 返回 false 表示本分片已经全部取完，快照随之结束
+    bool snapshotChunk(std::vector<SnapshotEntry>* out, size_t max_entries, size_t max_bytes) {
+        // 共享锁排除了写入者；只有快照线程在共享锁内修改快照状态
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        size_t bytes = 0;
+        while (!snapshot_saved_.empty() && out->size() < max_entries && bytes < max_bytes) {
+            bytes += snapshot_saved_.back().key.size() + snapshot_saved_.back().view().size();
+            out->push_back(std::move(snapshot_saved_.back()));
+            snapshot_saved_.pop_back();
+        }
+        while (snapshot_cursor_ < entries_.size() && out->size() < max_entries && bytes < max_bytes) {
+            Entry& entry = entries_[snapshot_cursor_++];
+            if (entry.snapshot_epoch == snapshot_epoch_) {
+                continue;
+            }
+            entry.snapshot_epoch = snapshot_epoch_;
+            out->push_back(snapshotCopy(entry));
+            bytes += entry.key.size() + entry.view().size();
+        }
+        if (snapshot_cursor_ < entries_.size() || !snapshot_saved_.empty()) {
+            return true;
+        }
+        snapshot_epoch_ = 0;
+        std::vector<SnapshotEntry>().swap(snapshot_saved_);
+        return false;
+    }
+
+    // 写盘失败时放弃快照
+    void abortSnapshot() {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        snapshot_epoch_ = 0;
+        std::vector<SnapshotEntry>().swap(snapshot_saved_);
+    }
+
+    // 本次快照期间为快照保留旧版本的键数
+    uint64_t snapshotCowEntries() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return snapshot_cow_entries_;
+    }
+
+    size_t size() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return entries_.size();
+    }
 
+    size_t usedMemory() {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return used_memory_;
+    }
+
+private:
+    uint32_t slotCount() const override { return static_cast<uint32_t>(entries_.size()); }
+    EvictionMeta& slotMeta(uint32_t slot) override { return entries_[slot].meta; }
+    uint64_t slotHash(uint32_t slot) override { return entries_[slot].hash; }
+    size_t slotCharge(uint32_t slot) override { return entries_[slot].charge; }
+
+    // 按相对 TTL 写入并追加日志（调用方持有独占锁），返回需要等待落盘的 LSN，没有日志时为 0。
+    // 在锁内写日志，同一个键的日志顺序与执行顺序一致
+    uint64_t setAndLogLocked(std::string_view key, uint64_t hash, std::string_view value,
+                             std::chrono::milliseconds ttl, SetResult* result) {
+        uint64_t expire_ms = kNoExpire; // 无过期时间
+        if (ttl.count() != 0) {
+            expire_ms = CoarseClock::nowMs() + static_cast<uint64_t>(ttl.count());
+        }
+        *result = setLocked(key, hash, value, expire_ms);
+        if (!wal_) {
+            return 0;
+        }
+        uint64_t expire = expire_ms == kNoExpire ? kWalNoExpire
+                                                 : static_cast<uint64_t>(CoarseClock::toWallMs(expire_ms));
+        return wal_->appendSet(key, value, expire);
+    }
+
+    // 写入或覆盖一个键（调用方持有独占锁）
+    SetResult setLocked(std::string_view key, uint64_t hash, std::string_view value, uint64_t expire_ms) {
+        SetResult result;
         // 检查是否覆盖已有键
-        auto it = store_.find(key);
-        if (it != store_.end()) {
-            access_order_.erase(it->second.it);
+        uint32_t slot = find(key, hash);
+        if (slot != SwissIndex::kNotFound) {
+            Entry& entry = entries_[slot];
+            preserveForSnapshot(entry);
+            assignValue(entry, value);
+            entry.expire_ms = expire_ms;
+            scheduleExpiry(slot);
+            used_memory_ -= entry.charge;
+            entry.charge = entryCharge(entry);
+            used_memory_ += entry.charge;
+            // 覆盖已有键视为一次访问
+            policy_->onAccess(slot, entry.meta);
             result.overwritten = true;
         } else {
             result.overwritten = false;
+
+            // 插入新键
+            slot = static_cast<uint32_t>(entries_.size());
+            Entry& entry = entries_.push_back();
+            entry.key = key;
+            assignValue(entry, value);
+            entry.expire_ms = expire_ms;
+            entry.hash = hash;
+            entry.snapshot_epoch = snapshot_epoch_;  // 快照开始后插入的键不属于快照
+            entry.charge = entryCharge(entry);
+            used_memory_ += entry.charge;
+            index_.insert(hash, slot);
+            scheduleExpiry(slot);
+            policy_->onInsert(slot, entry.meta);
         }
 
-        // 插入新键
-        access_order_.push_front(key);
-        store_[key] = {value, expire_time, access_order_.begin()};
+        // 检查是否超出键数或内存限制（只在本分片内淘汰）
+        result.evicted = evictIfNeeded();
+        return result;
+    }
 
-        // 检查是否触发容量淘汰
-        if (store_.size() > max_capacity_) {
-            auto last_key = access_order_.back();
-            access_order_.pop_back();
-            store_.erase(last_key);
-            result.evicted = true;
+    // 大值每次写入都分配新的共享存储，不原地修改，正在发送旧值的连接不受影响
+    void assignValue(Entry& entry, std::string_view value) {
+        if (shared_value_bytes_ > 0 && value.size() >= shared_value_bytes_) {
+            entry.shared = std::make_shared<const std::string>(value);
+            std::string().swap(entry.value);
         } else {
-            result.evicted = false;
+            entry.shared.reset();
+            entry.value = value;
         }
+    }
 
-        return result;
+    static uint64_t nowTick(int64_t tick_ms) {
+        return CoarseClock::nowMs() / static_cast<uint64_t>(tick_ms);
+    }
+
+    // 按过期时间把槽位挂到时间轮上，向上取整到 tick，保证不会提前删除；没有 TTL 的键不挂
+    void scheduleExpiry(uint32_t slot) {
+        const Entry& entry = entries_[slot];
+        if (entry.expire_ms == kNoExpire) {
+            wheel_.cancel(slot);
+            return;
+        }
+        uint64_t tick_ms = static_cast<uint64_t>(expire_tick_ms_);
+        wheel_.schedule(slot, (entry.expire_ms + tick_ms - 1) / tick_ms);
+    }
+
+    uint64_t nextRandom() {
+        // xorshift64*，只在独占锁内调用
+        rng_state_ ^= rng_state_ >> 12;
+        rng_state_ ^= rng_state_ << 25;
+        rng_state_ ^= rng_state_ >> 27;
+        return rng_state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint32_t find(std::string_view key, uint64_t hash) const {
+        return index_.find(hash, [&](uint32_t slot) { return entries_[slot].key == key; });
+    }
+
+    // 字符串在堆上占用的字节数：短字符串优化（SSO）时为 0，否则按 malloc 头部和 16 字节对齐估算
+    static size_t heapBytes(const std::string& s) {
+        const char* self = reinterpret_cast<const char*>(&s);
+        if (s.data() >= self && s.data() < self + sizeof(s)) {
+            return 0;
+        }
+        return (s.capacity() + 1 + sizeof(size_t) + 15) & ~static_cast<size_t>(15);
+    }
+
+    // 估算一个键值对的内存：槽位 + 索引位置（控制字节和下标，按 7/8 负载折算）+ 时间轮元数据 + 键值的堆内存；
+    // 共享存储的值另加 make_shared 的控制块和字符串对象
+    static uint32_t entryCharge(const Entry& entry) {
+        size_t index = (sizeof(int8_t) + sizeof(uint32_t)) * 8 / 7 + 1;
+        size_t charge = sizeof(Entry) + index + TimingWheel::kSlotBytes + heapBytes(entry.key) + heapBytes(entry.value);
+        if (entry.shared) {
+            charge += kSharedValueOverhead + heapBytes(*entry.shared);
+        }
+        return charge > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(charge);
+    }
+
+    bool overLimit() const {
+        return (max_capacity_ > 0 && entries_.size() > max_capacity_) ||
+               (max_memory_ > 0 && used_memory_ > max_memory_);
+    }
+
+    // 超出限制时循环淘汰，返回是否淘汰了键（调用方持有独占锁）
+    bool evictIfNeeded() {
+        bool evicted = false;
+        while (overLimit() && !entries_.empty()) {
+            evictOne();
+            evicted = true;
+        }
+        return evicted;
+    }
+
+    // 删除一个键：最后一个槽位搬到被删除的位置，保持槽位连续（调用方持有独占锁）
+    void removeEntry(uint32_t slot) {
+        uint32_t last = static_cast<uint32_t>(entries_.size() - 1);
+        preserveForSnapshot(entries_[slot]);
+        if (slot != last && slot < snapshot_cursor_) {
+            // 最后一个槽位搬到快照游标已经扫过的位置，快照线程不会再看到它
+            preserveForSnapshot(entries_[last]);
+        }
+        policy_->onRemove(slot);
+        index_.erase(entries_[slot].hash, slot);
+        wheel_.cancel(slot);
+        used_memory_ -= entries_[slot].charge;
+        if (slot != last) {
+            entries_[slot] = std::move(entries_[last]);
+            index_.replace(entries_[slot].hash, last, slot);
+            wheel_.move(last, slot);
+            policy_->onMove(last, slot);
+        }
+        entries_.pop_back();
+    }
+
+    static SnapshotEntry snapshotCopy(const Entry& entry) {
+        SnapshotEntry copy;
+        copy.key = entry.key;
+        if (entry.shared) {
+            copy.shared = entry.shared;
+        } else {
+            copy.value = entry.value;
+        }
+        copy.expire_ms = entry.expire_ms;
+        return copy;
+    }
+
+    // 快照进行中且该键还没写入快照时，修改前把旧版本交给快照线程（调用方持有独占锁）
+    void preserveForSnapshot(Entry& entry) {
+        if (snapshot_epoch_ == 0 || entry.snapshot_epoch == snapshot_epoch_) {
+            return;
+        }
+        entry.snapshot_epoch = snapshot_epoch_;
+        snapshot_saved_.push_back(snapshotCopy(entry));
+        ++snapshot_cow_entries_;
+    }
+
+    // 由淘汰策略选出一个槽位并删除（调用方持有独占锁）
+    void evictOne() {
+        if (entries_.empty()) {
+            return;
+        }
+        removeEntry(policy_->selectVictim(*this));
+    }
+
+    SlotArray<Entry> entries_;
+    SwissIndex index_;
+    TimingWheel wheel_;
+    int64_t expire_tick_ms_ = kDefaultExpireTickMs;
+    size_t shared_value_bytes_ = 0;
+    WriteAheadLog* wal_ = nullptr;
+    uint32_t snapshot_epoch_ = 0;      // 进行中的快照编号，0 表示没有
+    size_t snapshot_cursor_ = 0;       // 快照线程扫描到的槽位
+    std::vector<SnapshotEntry> snapshot_saved_;  // 写入者为快照保留的旧版本
+    uint64_t snapshot_cow_entries_ = 0;
+    uint64_t rng_state_ = 0x9E3779B97F4A7C15ULL;
+    size_t max_capacity_;
+    size_t max_memory_;
+    size_t used_memory_ = 0;
+    std::unique_ptr<EvictionPolicy> policy_;
+    std::shared_mutex mutex_;
+};
+
+
+//kv存储系统：按 key 哈希路由到 N 个独立加锁的分片
+class KVStore {
+public:
+    static constexpr size_t kDefaultShardCount = 16;
+    static constexpr size_t kSnapshotChunkEntries = 1024;   // 快照每批在分片锁内拷出的键数上限
+    static constexpr size_t kSnapshotChunkBytes = 1 << 20;  // 以及字节数上限
+    static constexpr size_t kRewriteChunkBytes = 1 << 20;   // 日志重写每次写盘的字节数
+
+    static KVStore& getInstance() { //单例模式
+        static KVStore instance;
+        return instance;
+    }
+
+    KVStore(const KVStore&) = delete;
+    KVStore& operator=(const KVStore&) = delete;
+
+    // 设置分片数量，会重建所有分片（丢弃已有数据），只能在启动服务前调用
+    void setShardCount(size_t count) {
+        if (count == 0) {
+            count = 1;
+        }
+        std::vector<std::unique_ptr<KVShard>> shards;
+        shards.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            shards.emplace_back(new KVShard(shardCapacity(max_capacity_, count),
+                                            shardCapacity(max_memory_, count)));
+        }
+        shards_.swap(shards);
+    }
+
+    size_t shardCount() const { return shards_.size(); }
+
+    // 设置淘汰策略（clock / sampled_lru / wtinylfu），每个分片各自持有一个实例
+    bool setEvictionPolicy(const std::string& name, size_t samples = 5) {
+        for (auto& shard : shards_) {
+            auto policy = createEvictionPolicy(name, samples);
+            if (!policy) {
+                return false;
+            }
+            shard->setEvictionPolicy(std::move(policy));
+        }
+        return true;
+    }
+
+    // 设置缓存最大键数（0 表示不限制），平均分摊到每个分片
+    void setMaxCapacity(size_t capacity) {
+        max_capacity_ = capacity;
+        size_t per_shard = shardCapacity(capacity, shards_.size());
+        for (auto& shard : shards_) {
+            shard->setMaxCapacity(per_shard);
+        }
+    }
+
+    // 设置最大内存（字节，0 表示不限制），平均分摊到每个分片，超出时按淘汰策略淘汰
+    void setMaxMemory(size_t max_memory) {
+        max_memory_ = max_memory;
+        size_t per_shard = shardCapacity(max_memory, shards_.size());
+        for (auto& shard : shards_) {
+            shard->setMaxMemory(per_shard);
+        }
+    }
+
+    // 所有分片估算的内存占用之和
+    size_t usedMemory() {
+        size_t total = 0;
+        for (auto& shard : shards_) {
+            total += shard->usedMemory();
+        }
+        return total;
+    }
+
+    GetResult get(std::string_view key) {
+        uint64_t hash = hashKey(key);
+        return shardFor(hash).get(key, hash);
+    }
+
+    // 命中时以 string_view 调用 sink(value)，见 KVShard::getWith
+    template <typename Sink>
+    GetResult getWith(std::string_view key, Sink&& sink) {
+        uint64_t hash = hashKey(key);
+        return shardFor(hash).getWith(key, hash, std::forward<Sink>(sink));
+    }
+
+    // 同步设置 key 并指定过期时间
+    SetResult set(std::string_view key, std::string_view value, std::chrono::milliseconds ttl = std::chrono::seconds(60)) {
+        uint64_t hash = hashKey(key);
+        return shardFor(hash).set(key, hash, value, ttl);
+    }
+
+    // 回源填充，键已存在时不覆盖
+    bool fill(std::string_view key, std::string_view value, std::chrono::milliseconds ttl) {
+        uint64_t hash = hashKey(key);
+        return shardFor(hash).fill(key, hash, value, ttl);
     }
 
     // 异步设置 key 并指定过期时间
-    void asyncSet(const string& key, const string& value, std::chrono::seconds ttl, 
+    void asyncSet(const string& key, const string& value, std::chrono::milliseconds ttl, 
                   std::function<void(SetResult)> callback = nullptr) {
         {
             std::lock_guard<std::mutex> lock(task_mutex_);
@@ -125,63 +759,313 @@ public:
         task_cv_.notify_one();
     }
 
-    bool del(const std::string& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = store_.find(key);
-        if (it == store_.end()) {
-            return false;  // 未找到 key
+    bool del(std::string_view key) {
+        uint64_t hash = hashKey(key);
+        return shardFor(hash).del(key, hash);
+    }
+
+    // 数据持久化为二进制快照（格式见 snapshot.h），写完后原子替换 filename，失败时保留原文件。
+    // 快照不阻塞写入方，见 scanSnapshot
+    bool persistToFile(const std::string& filename, const SnapshotOptions& options = SnapshotOptions(),
+                       std::string* error = nullptr) {
+        std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            snapshot_stats_.in_progress = true;
         }
-        access_order_.erase(it->second.it);  // 从访问顺序中移除
-        store_.erase(it);  // 从存储中删除
-        return true;  // 成功删除
+        SnapshotWriter writer(options);
+        uint64_t cow_entries = 0;
+        bool ok = writer.open(filename);
+        if (ok) {
+            ok = scanSnapshot([]() {}, [&](const KVShard::SnapshotEntry& entry) {
+                uint64_t expire = kSnapshotNoExpire;
+                if (entry.expire_ms != KVShard::kNoExpire) {
+                    expire = static_cast<uint64_t>(CoarseClock::toWallMs(entry.expire_ms));
+                }
+                return writer.add(entry.key, entry.view(), expire);
+            }, &cow_entries);
+        }
+        ok = writer.finish() && ok;
+        if (!ok && error) {
+            *error = writer.error();
+        }
+
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        SnapshotStats& stats = snapshot_stats_;
+        stats.in_progress = false;
+        stats.last_ok = ok;
+        stats.last_time = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        stats.last_duration_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        if (ok) {
+            ++stats.snapshots;
+            stats.last_bytes = writer.bytesWritten();
+            stats.last_keys = writer.records();
+            stats.last_cow_entries = cow_entries;
+        } else {
+            ++stats.failures;
+        }
+        return ok;
     }
 
-    // 数据持久化到文件
-    void persistToFile(const std::string& filename) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            for (const auto& entry : store_) {
-                const auto& key = entry.first;
-                const auto& value = entry.second.value;
-                auto expire_time = entry.second.expire_time.time_since_epoch().count();
-                file << key << "\t" << value << "\t" << expire_time << "\n";
+    // 重写变更日志：从存储的一致快照生成只含每个键当前值的新日志，快照时刻之后的写入追加在末尾，
+    // 完成后原子替换旧日志（见 wal.h）。与快照共用分片的快照状态，两者串行执行
+    bool rewriteLog(std::string* error = nullptr) {
+        std::string ignored;
+        std::string& err = error ? *error : ignored;
+        if (!wal_) {
+            err = "write-ahead log is disabled";
+            return false;
+        }
+        std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
+        if (!wal_->beginRewrite(&err)) {
+            return false;
+        }
+        std::string buf;
+        uint64_t now = CoarseClock::nowMs();
+        bool ok = scanSnapshot([this]() { wal_->markRewritePoint(); }, [&](const KVShard::SnapshotEntry& entry) {
+            uint64_t expire = kWalNoExpire;
+            if (entry.expire_ms != KVShard::kNoExpire) {
+                if (entry.expire_ms < now) {
+                    return true;  // 已过期的键不写入
+                }
+                expire = static_cast<uint64_t>(CoarseClock::toWallMs(entry.expire_ms));
+            }
+            WriteAheadLog::encodeRecord(&buf, kWalSet, entry.key, entry.view(), expire);
+            if (buf.size() >= kRewriteChunkBytes) {
+                bool written = wal_->appendRewrite(buf.data(), buf.size());
+                buf.clear();
+                return written;
             }
-            file.close();
+            return true;
+        }, nullptr);
+        ok = ok && (buf.empty() || wal_->appendRewrite(buf.data(), buf.size()));
+        if (!ok) {
+            err = "write rewrite file failed";
+            wal_->abortRewrite();
+            return false;
         }
+        return wal_->finishRewrite(&err);
     }
 
-    // 从文件加载持久化数据
-    void loadFromFile(const std::string& filename) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::ifstream file(filename);
-        if (file.is_open()) {
-            std::string line;
-            while (std::getline(file, line)) {
-                std::istringstream iss(line);
-                std::string key, value;
-                int64_t expire_time_count;
-                if (std::getline(iss, key, '\t') && 
-                    std::getline(iss, value, '\t') && 
-                    (iss >> expire_time_count)) {
-                    auto expire_time = std::chrono::system_clock::time_point(
-                        std::chrono::nanoseconds(expire_time_count));
-                    if (std::chrono::system_clock::now() < expire_time) {
-                        set(key, value, std::chrono::duration_cast<std::chrono::seconds>(
-                            expire_time - std::chrono::system_clock::now()));
+    SnapshotStats snapshotStats() {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        return snapshot_stats_;
+    }
+
+    // 从快照加载持久化数据：threads 个线程（0 表示按 CPU 核数）按文件尾的块索引各自领取数据块，
+    // 并行读取、校验 CRC、解压、解析，按分片分组后批量写入（每组只加一次分片锁），跳过已过期的键。
+    // 快照中每个键只出现一次，块之间没有顺序依赖。遇到损坏的块时停止并返回 false，已载入的块保留。
+    // 旧的文本格式文件按行解析
+    bool loadFromFile(const std::string& filename, std::string* error = nullptr, LoadStats* stats = nullptr,
+                      size_t threads = 0) {
+        auto start = std::chrono::steady_clock::now();
+        if (!SnapshotReader::isSnapshotFile(filename)) {
+            return loadTextFile(filename, error);
+        }
+        SnapshotReader reader;
+        if (!reader.open(filename)) {
+            if (error) *error = reader.error();
+            return false;
+        }
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, std::max<size_t>(1, reader.blockCount()));
+
+        std::atomic<size_t> next_block{0};
+        std::atomic<uint64_t> keys{0};
+        std::atomic<bool> failed{false};
+        std::mutex error_mutex;
+        std::string first_error;
+        uint64_t now = CoarseClock::nowMs();
+        auto worker = [&](size_t id) {
+            std::string raw;
+            std::vector<std::vector<KVShard::BatchEntry>> batches(shards_.size());
+            uint64_t loaded = 0;
+            while (!failed.load(std::memory_order_relaxed)) {
+                size_t i = next_block.fetch_add(1, std::memory_order_relaxed);
+                if (i >= reader.blockCount()) {
+                    break;
+                }
+                auto fail = [&](const std::string& what) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (first_error.empty()) {
+                        first_error = what;
+                    }
+                    failed = true;
+                };
+                if (!reader.readBlock(i, &raw)) {
+                    fail("block " + std::to_string(i) + " corrupted");
+                    break;
+                }
+                bool ok = SnapshotReader::parseBlock(raw, reader.block(i).records, [&](const SnapshotRecord& record) {
+                    KVShard::BatchEntry entry;
+                    if (record.expire_ms != kSnapshotNoExpire) {
+                        entry.expire_ms = CoarseClock::fromWallMs(static_cast<int64_t>(record.expire_ms));
+                        if (entry.expire_ms <= now) {
+                            return;
+                        }
+                    }
+                    entry.key = record.key;
+                    entry.value = record.value;
+                    entry.hash = hashKey(record.key);
+                    batches[shardIndex(entry.hash, shards_.size())].push_back(entry);
+                });
+                if (!ok) {
+                    fail("block " + std::to_string(i) + " malformed");
+                    break;
+                }
+                // 各线程从不同的分片开始写入，减少同时争抢一个分片的锁
+                for (size_t k = 0; k < batches.size(); ++k) {
+                    size_t s = (id + k) % batches.size();
+                    if (!batches[s].empty()) {
+                        shards_[s]->insertBatch(batches[s].data(), batches[s].size());
+                        loaded += batches[s].size();
+                        batches[s].clear();
                     }
                 }
             }
-            file.close();
+            keys += loaded;
+        };
+        std::vector<std::thread> workers;
+        for (size_t id = 1; id < threads; ++id) {
+            workers.emplace_back(worker, id);
+        }
+        worker(0);
+        for (auto& t : workers) {
+            t.join();
+        }
+        if (stats) {
+            stats->keys = keys;
+            stats->bytes = reader.fileSize();
+            stats->threads = threads;
+            stats->elapsed_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+        if (failed) {
+            if (error) *error = first_error;
+            return false;
+        }
+        return true;
+    }
+
+    // 回放变更日志（在快照之后），然后打开日志记录之后的 set / del；
+    // replayed 返回回放的记录数。日志尾部不完整的记录（崩溃时没写完）会被截掉
+    bool openWriteAheadLog(const std::string& filename, const WalOptions& options, uint64_t* replayed,
+                           std::string* error) {
+        uint64_t valid_bytes = 0;
+        uint64_t records = 0;
+        uint64_t now = CoarseClock::nowMs();
+        bool ok = WriteAheadLog::replay(filename, [&](const WalRecord& record) {
+            uint64_t hash = hashKey(record.key);
+            KVShard& shard = shardFor(hash);
+            if (record.op == kWalDel) {
+                shard.remove(record.key, hash);
+                return;
+            }
+            uint64_t expire_ms = KVShard::kNoExpire;
+            if (record.expire_ms != kWalNoExpire) {
+                expire_ms = CoarseClock::fromWallMs(static_cast<int64_t>(record.expire_ms));
+                if (expire_ms <= now) {
+                    shard.remove(record.key, hash);  // 已过期，等同于删除之前的值
+                    return;
+                }
+            }
+            shard.setExpireAt(record.key, hash, record.value, expire_ms);
+        }, &valid_bytes, &records, error);
+        if (!ok) {
+            return false;
+        }
+        if (replayed) {
+            *replayed = records;
+        }
+        std::unique_ptr<WriteAheadLog> wal(new WriteAheadLog());
+        if (!wal->open(filename, valid_bytes, options, error)) {
+            return false;
+        }
+        wal_ = std::move(wal);
+        for (auto& shard : shards_) {
+            shard->setWriteAheadLog(wal_.get());
+        }
+        return true;
+    }
+
+    bool walEnabled() const { return wal_ != nullptr; }
+
+    WalStats walStats() {
+        return wal_ ? wal_->stats() : WalStats();
+    }
+
+    // 不小于 bytes 的值按引用计数保存，服务器可以零拷贝发送；0 表示全部内联保存
+    void setSharedValueThreshold(size_t bytes) {
+        for (auto& shard : shards_) {
+            shard->setSharedValueThreshold(bytes);
         }
     }
 
-    // 启动定时清理过期 key 的任务
-    void startExpirationCleaner(std::chrono::seconds interval) {
-        std::thread([this, interval]() {
+    // 设置过期时间轮的 tick 精度，只能在启动服务前调用
+    void setExpireTick(std::chrono::milliseconds tick) {
+        for (auto& shard : shards_) {
+            shard->setExpireTick(tick);
+        }
+    }
+
+    // 启动定时清理过期 key 的任务：每个 tick 推进各分片的时间轮，
+    // 每个分片每次最多删除 max_keys_per_tick 个到期的 key，避免长时间持锁
+    void startExpirationCleaner(std::chrono::milliseconds tick, size_t max_keys_per_tick) {
+        std::thread([this, tick, max_keys_per_tick]() {
+            while (true) {
+                std::this_thread::sleep_for(tick);
+                for (auto& shard : shards_) {
+                    shard->expireKeys(max_keys_per_tick);
+                }
+            }
+        }).detach();
+    }
+
+    // 启动 Redis 风格的自适应主动过期任务（替代时间轮清理）：每隔 interval 从各分片
+    // 随机采样 samples 个带 TTL 的键并删除过期的，某个分片过期比例超过 ratio_percent% 时
+    // 继续采样该分片；每轮总耗时不超过 budget，超时后下一轮从中断的分片继续
+    void startAdaptiveExpireCycle(std::chrono::milliseconds interval, std::chrono::microseconds budget,
+                                  size_t samples, size_t ratio_percent) {
+        std::thread([this, interval, budget, samples, ratio_percent]() {
+            size_t next_shard = 0;
             while (true) {
                 std::this_thread::sleep_for(interval);
-                cleanExpiredKeys();
+                auto deadline = std::chrono::steady_clock::now() + budget;
+                bool timeout = false;
+                for (size_t i = 0; i < shards_.size() && !timeout; ++i) {
+                    KVShard& shard = *shards_[next_shard];
+                    while (true) {
+                        ExpireSample sample = shard.sampleExpired(samples);
+                        if (std::chrono::steady_clock::now() >= deadline) {
+                            timeout = true;
+                            break;
+                        }
+                        if (sample.sampled == 0 || sample.expired * 100 <= sample.sampled * ratio_percent) {
+                            break;
+                        }
+                    }
+                    if (!timeout) {
+                        next_shard = (next_shard + 1) % shards_.size();
+                    }
+                }
+            }
+        }).detach();
+    }
+
+    // 启动后台渐进式扩容任务：每隔 interval 为每个正在迁移的分片迁移最多 groups 个组，
+    // 让大表扩容不依赖前台写入推进，也不会在单次 set 中整体重建
+    void startRehashWorker(std::chrono::milliseconds interval, size_t groups) {
+        std::thread([this, interval, groups]() {
+            while (true) {
+                std::this_thread::sleep_for(interval);
+                for (auto& shard : shards_) {
+                    shard->rehashStep(groups);
+                }
             }
         }).detach();
     }
@@ -221,7 +1105,9 @@ public:
         }
     }
 
-    KVStore() : max_capacity_(100) {
+    KVStore() : max_capacity_(100), max_memory_(0) {
+        CoarseClock::start();
+        setShardCount(kDefaultShardCount);
         startWorkerThread();
     }
 
@@ -229,30 +1115,125 @@ public:
         stopWorkerThread();
     }
 
-    struct Entry {
-        std::string value;
-        std::chrono::system_clock::time_point expire_time;
-        std::list<std::string>::iterator it;
-    };
-
-    // 清理过期的 key
+    // 清理所有已到期的 key，每次只锁一个分片
     void cleanExpiredKeys() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto now = std::chrono::system_clock::now();
-        for (auto it = store_.begin(); it != store_.end(); ) {
-            if (now > it->second.expire_time) {
-                access_order_.erase(it->second.it);
-                it = store_.erase(it);
-            } else {
-                ++it;
+        for (auto& shard : shards_) {
+            shard->expireKeys(SIZE_MAX);
+        }
+    }
+
+    // std::hash<std::string_view> 与 std::hash<std::string> 对相同内容的结果一致
+    static uint64_t hashKey(std::string_view key) {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    // key 所在分片的下标，按分片划分归属的服务器（每核一个 io_uring 的 proactor）据此路由请求
+    size_t shardIndexOf(std::string_view key) const {
+        return shardIndex(hashKey(key), shards_.size());
+    }
+
+    // 以一致的时间点遍历所有分片：同时锁住所有分片，设置快照编号并调用 on_begin（只在锁内做很少的事），
+    // 之后逐批在共享锁内拷出记录、不持锁调用 fn(entry)，写入方照常执行，见 KVShard::beginSnapshotLocked。
+    // fn 返回 false 时放弃快照；调用方持有 snapshot_mutex_
+    template <typename BeginFn, typename Fn>
+    bool scanSnapshot(BeginFn&& on_begin, Fn&& fn, uint64_t* cow_entries) {
+        uint32_t epoch = ++snapshot_epoch_;
+        if (epoch == 0) {
+            epoch = ++snapshot_epoch_;
+        }
+        {
+            std::vector<std::unique_lock<std::shared_mutex>> locks;
+            locks.reserve(shards_.size());
+            for (auto& shard : shards_) {
+                locks.push_back(shard->exclusiveLock());
+            }
+            for (auto& shard : shards_) {
+                shard->beginSnapshotLocked(epoch);
+            }
+            on_begin();
+        }
+        bool ok = true;
+        std::vector<KVShard::SnapshotEntry> chunk;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            bool more = ok;
+            while (more) {
+                more = shards_[i]->snapshotChunk(&chunk, kSnapshotChunkEntries, kSnapshotChunkBytes);
+                for (const KVShard::SnapshotEntry& entry : chunk) {
+                    if (!fn(entry)) {
+                        ok = false;
+                        more = false;
+                        break;
+                    }
+                }
+                chunk.clear();
+            }
+            if (!ok) {
+                shards_[i]->abortSnapshot();
+                continue;
+            }
+            if (cow_entries) {
+                *cow_entries += shards_[i]->snapshotCowEntries();
+            }
+        }
+        return ok;
+    }
+
+    // 旧版 key\tvalue\texpire_ns 文本格式，只用于升级后载入旧文件
+    bool loadTextFile(const std::string& filename, std::string* error) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            if (error) *error = "open " + filename + " failed";
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream iss(line);
+            std::string key, value;
+            int64_t expire_time_count;
+            if (std::getline(iss, key, '\t') &&
+                std::getline(iss, value, '\t') &&
+                (iss >> expire_time_count)) {
+                uint64_t hash = hashKey(key);
+                if (expire_time_count == INT64_MAX) {
+                    shardFor(hash).setExpireAt(key, hash, value, KVShard::kNoExpire);
+                    continue;
+                }
+                uint64_t expire_ms = CoarseClock::fromWallMs(expire_time_count / 1000000);
+                if (CoarseClock::nowMs() < expire_ms) {
+                    shardFor(hash).setExpireAt(key, hash, value, expire_ms);
+                }
             }
         }
+        return true;
     }
 
-    std::unordered_map<std::string, Entry> store_;
-    std::list<std::string> access_order_;
+    // 根据 key 的哈希值选择分片
+    KVShard& shardFor(uint64_t hash) {
+        return *shards_[shardIndex(hash, shards_.size())];
+    }
+
+    // 用乘法散列的高位做区间映射，避免与分片内哈希表使用的低位相关
+    static size_t shardIndex(size_t hash, size_t count) {
+        uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * count) >> 64);
+    }
+
+    static size_t shardCapacity(size_t capacity, size_t count) {
+        if (count == 0) {
+            return capacity;
+        }
+        return (capacity + count - 1) / count;
+    }
+
+    std::vector<std::unique_ptr<KVShard>> shards_;
     size_t max_capacity_;
-    std::mutex mutex_;
+    size_t max_memory_;
+
+    std::unique_ptr<WriteAheadLog> wal_;
+    std::mutex snapshot_mutex_;  // 串行化快照
+    uint32_t snapshot_epoch_ = 0;
+    std::mutex stats_mutex_;
+    SnapshotStats snapshot_stats_;
 
     std::queue<std::function<void()>> task_queue_;
     std::mutex task_mutex_;
@@ -260,3 +1241,5 @@ public:
     std::thread worker_thread_;
     bool worker_running_ = false;
 };
+
+#endif
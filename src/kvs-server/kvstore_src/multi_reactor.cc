@@ -0,0 +1,120 @@
+#include <any>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpServer.h"
+#include "command_handler.h"
+#include "server.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 多 loop 反应堆：N 个 EventLoop 各跑在一个线程上，每个 loop 有自己的 TcpServer 和
+// SO_REUSEPORT 监听套接字，由内核把新连接分散到各个 loop；连接从此只属于接受它的 loop，
+// 命令在 loop 线程上直接执行并写回，没有线程池排队和 epoll_ctl 往返。
+// 需要回源 MySQL 的请求不在 loop 线程上执行：交给 DB 线程池，执行完后回到 loop 线程发送响应，
+// 期间该连接后续的请求留在输入缓冲区，保持响应顺序。
+namespace {
+
+// 每个 loop 线程复用一个输出缓冲区，一次读取产生的所有响应合并为一次 send
+thread_local Buffer t_output;
+
+// 连接的上下文
+struct LoopConn {
+    ProtocolState protocol;
+    bool db_pending = false;  // 有一条请求在 DB 线程池中执行
+};
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* input, Timestamp);
+
+void onConnection(const TcpConnectionPtr& conn) {
+    if (conn->connected()) {
+        conn->setTcpNoDelay(true);
+        conn->setContext(LoopConn());
+    }
+}
+
+// 在 DB 线程池中执行输入缓冲区开头那条需要回源的请求，响应回到 loop 线程发送后继续处理之后的请求
+void deferToDb(const TcpConnectionPtr& conn, Buffer* input, LoopConn* state) {
+    RequestRoute route;
+    routeRequest(input->peek(), input->readableBytes(), &state->protocol, &route);
+    std::string request(input->peek(), route.length);
+    state->db_pending = true;
+    int resp_version = state->protocol.resp.version;
+    // route.key 指向 input，提交（按键选择 DB 线程）之后再从 input 中取走请求
+    dbCacheSubmit(route.key, [conn, request = std::move(request), resp_version]() {
+        Buffer in;
+        Buffer out;
+        in.append(request.data(), request.size());
+        ProtocolState protocol;
+        protocol.resp.version = resp_version;
+        bool keep_open = handleInput(&in, &out, &protocol);
+        std::string response = out.retrieveAllAsString();
+        conn->getLoop()->runInLoop([conn, response = std::move(response), keep_open]() {
+            if (!conn->connected()) {
+                return;
+            }
+            std::any_cast<LoopConn>(conn->getMutableContext())->db_pending = false;
+            conn->send(response);
+            if (!keep_open) {
+                conn->shutdown();
+                return;
+            }
+            onMessage(conn, conn->inputBuffer(), Timestamp());
+        });
+    });
+    input->retrieve(route.length);
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* input, Timestamp) {
+    LoopConn* state = std::any_cast<LoopConn>(conn->getMutableContext());
+    if (state->db_pending) {
+        return;  // 等 DB 线程池中的请求完成后再处理
+    }
+    bool keep_open = handleInput(input, &t_output, &state->protocol);
+    if (t_output.readableBytes() > 0) {
+        conn->send(&t_output);  // 在 loop 线程内发送，写不完的部分由 TcpConnection 缓存
+    }
+    if (!keep_open) {
+        conn->shutdown();  // 协议错误或 QUIT：发送完剩余响应后关闭
+        return;
+    }
+    if (state->protocol.db_deferred) {
+        state->protocol.db_deferred = false;
+        deferToDb(conn, input, state);
+    }
+}
+
+}  // namespace
+
+void runMultiReactorServer(int loops) {
+    if (loops <= 0) {
+        loops = static_cast<int>(std::thread::hardware_concurrency());
+        if (loops <= 0) loops = 1;
+    }
+    EventLoop base_loop;
+    EventLoopThreadPool pool(&base_loop, "kvs-loop");
+    pool.setThreadNum(loops);
+
+    InetAddress listen_addr(2000);
+    std::mutex servers_mutex;
+    std::vector<std::unique_ptr<TcpServer>> servers;
+    // 在每个 loop 线程启动时创建该 loop 专属的 TcpServer（不再分发到其他线程）
+    pool.start([&](EventLoop* loop) {
+        dbCacheSetAsync(true);
+        std::unique_ptr<TcpServer> server(
+            new TcpServer(loop, listen_addr, "kvstore", TcpServer::kReusePort));
+        server->setConnectionCallback(onConnection);
+        server->setMessageCallback(onMessage);
+        server->start();
+        std::lock_guard<std::mutex> lock(servers_mutex);
+        servers.push_back(std::move(server));
+    });
+    LOG_INFO << "multi reactor server started on port 2000 with " << loops << " loops";
+    base_loop.loop();
+}
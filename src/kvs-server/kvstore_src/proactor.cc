@@ -1,71 +1,261 @@
 #include <liburing.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <stdlib.h>
 #include <functional>
+#include <thread>
 #include <vector>
 #include <memory>
 #include "muduo/base/Logging.h"
+#include "muduo/net/Buffer.h"
+#include "buffer_pool.h"
 #include "command_handler.h"
+#include "server.h"
 
 #define EVENT_ACCEPT    0
 #define EVENT_READ      1
 #define EVENT_WRITE     2
+#define EVENT_FORWARD   3   // 其他 ring 转发来的请求（MSG_RING）
+#define EVENT_REPLY     4   // 转发出去的请求的响应（MSG_RING）
+#define EVENT_MSG_FAIL  5   // MSG_RING 投递失败（成功时不产生 CQE）
+#define EVENT_IGNORE    6   // 注册文件的 shutdown / close（成功时不产生 CQE）
+#define EVENT_SEND_VALUE 7  // SEND_ZC 直接从存储发送大值（成功时还有一个完成通知 CQE）
 
+// io_uring 服务器。默认模式下：
+//   - 监听套接字挂一个 multishot accept，每个新连接产生一个 CQE，不用每次重新提交；
+//   - 每个连接挂一个 multishot recv，数据由内核放进所有连接共享的 provided buffer ring，
+//     读出后立刻拷进连接的输入缓冲区并把 ring 缓冲区还回去，空闲连接不占用接收内存；
+//   - 每轮循环只调用一次 io_uring_submit_and_wait，处理完本轮所有 CQE 产生的 SQE 一起提交；
+//   - 新连接由 direct accept 直接放进 ring 的注册文件表，recv / send 用表中下标，不查进程 fd 表；
+//   - 响应拷进预先注册的 fixed buffer 用 WRITE_FIXED 发送，内核不必每次导入用户缓冲区；
+//   - 共享存储中的大值不拷进响应，响应和值组成输出链，用 SENDMSG 一次聚集发送；
+//     超过零拷贝阈值的值用 SEND_ZC 直接从存储发送，值被持有到内核的完成通知；
+//   - 发送因套接字不可写而挂起时，multishot recv 读进来的请求积压超过上限就取消 recv，
+//     发送完成、积压的请求处理完后再重新挂上，客户端只发不收时服务器内存不会无限增长。
+// 可选 SQPOLL：内核线程轮询 SQ，提交 SQE 不需要系统调用。
+// multishot 关闭（或内核不支持 buffer ring）时退回单次 accept / recv 到连接自己的缓冲区。
+//
+// 多个 ring 时每个 ring 一个线程（绑定到一个 CPU），各自有 SO_REUSEPORT 监听套接字，
+// 由内核把连接分散到各个 ring；KVStore 的分片按下标对 ring 数取模归属到各个 ring。
+// 单键请求的键属于本 ring 时直接执行，否则把请求原样通过 IORING_OP_MSG_RING 交给
+// 拥有该分片的 ring 执行，响应再用 MSG_RING 送回；每个分片只被一个线程访问，分片锁没有争用。
+// 连接上的响应按请求顺序排队，转发的响应回来后才发送排在后面的响应。
+//
+// 需要回源 MySQL 的请求（异步模式下 handleInput 停在这条请求上）不在 ring 线程上执行，
+// 同样作为一条转发消息交给 DB 线程池，执行完后 DB 线程用自己的小 ring 通过 MSG_RING 把响应送回发起方。
 class ProactorServer {
 public:
-    using MsgHandler = std::function<int(char*, int, char*)>;
-    
-    ProactorServer(unsigned short port, MsgHandler handler) 
-        : port_(port), msgHandler_(handler), listenFd_(-1) {
+    using MsgHandler = std::function<bool(muduo::net::Buffer*, muduo::net::Buffer*, ProtocolState*)>;
+
+    ProactorServer(unsigned short port, MsgHandler handler, const ProactorOptions& options, size_t index = 0)
+        : port_(port), listenFd_(-1), msgHandler_(handler), options_(options), index_(index) {
         struct io_uring_params params;
         memset(&params, 0, sizeof(params));
-        if (io_uring_queue_init_params(1024, &ring_, &params) < 0) {
-            LOG_SYSERR << "io_uring_queue_init failed";
+        if (options_.rings > 1) {
+            // 其他 ring 投递的响应和转发请求也占用 CQ，放大 CQ 以免溢出
+            params.flags |= IORING_SETUP_CQSIZE;
+            params.cq_entries = kCqEntries;
+        }
+        if (options_.sqpoll) {
+            params.flags |= IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = options_.sqpoll_idle_ms;
+        }
+        int ret = io_uring_queue_init_params(1024, &ring_, &params);
+        if (ret < 0 && options_.sqpoll) {
+            // 老内核上 SQPOLL 需要 CAP_SYS_ADMIN
+            LOG_ERROR << "io_uring SQPOLL setup failed: " << strerror(-ret) << ", disable sqpoll";
+            options_.sqpoll = false;
+            params.flags &= ~IORING_SETUP_SQPOLL;
+            ret = io_uring_queue_init_params(1024, &ring_, &params);
+        }
+        if (ret < 0) {
+            LOG_ERROR << "io_uring_queue_init failed: " << strerror(-ret);
             throw std::runtime_error("io_uring initialization failed");
         }
+        if (options_.multishot) {
+            initBufferRing();
+        }
+        if (options_.fixed_files > 0) {
+            initFixedFiles();
+        }
+        if (options_.fixed_buf_count > 0) {
+            initFixedBuffers();
+        }
         initServer();
-        LOG_INFO << "Proactor server initialized on port " << port_;
+        LOG_INFO << "Proactor server " << index_ << " initialized on port " << port_
+                 << (options_.multishot ? " (multishot)" : " (single shot)")
+                 << " fixed_files=" << options_.fixed_files << " fixed_bufs=" << options_.fixed_buf_count
+                 << (options_.sqpoll ? " sqpoll" : "");
+        peers_.push_back(this);
     }
 
     ~ProactorServer() {
         if (listenFd_ >= 0) close(listenFd_);
+        if (bufRing_) {
+            io_uring_free_buf_ring(&ring_, bufRing_, options_.buf_ring_entries, kBufferGroup);
+        }
         io_uring_queue_exit(&ring_);
         LOG_INFO << "Proactor server shutdown";
     }
 
+    // 所有 ring（按下标），启动前设置，之后只读
+    void setPeers(const std::vector<ProactorServer*>& peers) { peers_ = peers; }
+
     void run() {
+        dbCacheSetAsync(true);
         submitAcceptEvent();
         eventLoop();
     }
 
 private:
+    static const size_t kReadSize = 4096;  // 单次 recv 模式下每次 recv 至少预留的空间
+    static const int kBufferGroup = 0;
+    static const unsigned kCqEntries = 16384;
+    static const size_t kMaxForwardsPerConn = 64;  // 每个连接最多排队的转发请求数
+    static const size_t kMaxIov = 64;              // 一次聚集发送最多的段数
+    static const size_t kMaxPendingInput = 1024 * 1024;  // 发送挂起时输入缓冲区积压的上限
+    static const size_t kDbPool = SIZE_MAX;        // forwardRequest 的目标：DB 线程池
+
+    struct ConnInfo;
+
+    // 在 ring 之间传递的请求：由发起转发的 ring 分配和回收，执行方只填写 response
+    struct ShardMessage {
+        ConnInfo* conn = nullptr;  // 发起转发的连接，只由发起方访问
+        size_t origin = 0;         // 发起方 ring 下标
+        int resp_version = 2;      // 连接的 RESP 版本，执行方据此编码响应
+        bool local = false;        // 发起方本地执行的响应，只用于排队保持顺序
+        bool done = false;         // 响应已就绪，由发起方设置
+        bool zerocopy = false;     // 发起方连接启用零拷贝，执行方在 refs 中记录大值引用
+        bool db = false;           // 发起方交给 DB 线程池回源的请求
+        muduo::net::Buffer request;
+        muduo::net::Buffer response;
+        ZeroCopyRefs refs;         // response 中的大值引用
+    };
+
+    // 聚集发送的 msghdr 和 iovec，发送完成前内核可能还会读取，发送期间由连接持有
+    struct GatherSend {
+        msghdr msg;
+        iovec iov[kMaxIov];
+    };
+
+    // SEND_ZC 发送中的大值：持有值直到完成通知
+    struct ValueSend {
+        int fd = -1;
+        SharedValue value;
+    };
+
     struct ConnInfo {
-        int fd;
-        int event;
-        char buffer[1024];
-        char response[1024];
+        int fd = -1;
+        std::unique_ptr<muduo::net::Buffer> input;   // 已读到但还没处理完的请求
+        std::unique_ptr<muduo::net::Buffer> output;  // 待发送的响应
+        bool reading = false;       // 有一个 recv 在内核中
+        bool writing = false;       // 有一个 send 在内核中，output 不能改动
+        bool closing = false;       // 协议错误或对端关闭，发送完剩余响应后关闭
+        bool pausing = false;       // 输入积压，已提交取消 recv
+        bool db_pending = false;    // 有请求在 DB 线程池回源，之后的请求等它完成后再执行
+        int fixedBuf = -1;          // 发送中的响应所在的 fixed buffer，-1 表示直接发送 output
+        size_t fixedLen = 0;
+        size_t fixedSent = 0;
+        ProtocolState protocol;     // 连接级的协议状态（如 RESP 版本）
+        ZeroCopyRefs zerocopy;      // output 中的大值引用
+        std::unique_ptr<GatherSend> gather;  // 聚集发送中时持有
+        FifoQueue<std::unique_ptr<ShardMessage>> forwards;  // 还没写入 output 的响应，按请求顺序
+
+        bool hasOutput() const { return (output && output->readableBytes() > 0) || !zerocopy.empty(); }
     };
-    using ConnPtr = std::shared_ptr<ConnInfo>;
+
+    // user_data 编码为 fd << 8 | 事件类型；连接只在没有请求挂在内核中时关闭，不会收到过期的 CQE
+    static uint64_t makeUserData(int fd, int event) {
+        return (static_cast<uint64_t>(fd) << 8) | static_cast<uint64_t>(event);
+    }
+
+    // ring 之间的消息和发送中的大值编码为指针 << 8 | 事件类型（用户态地址不超过 56 位）
+    static uint64_t makeUserData(void* ptr, int event) {
+        return (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)) << 8) | static_cast<uint64_t>(event);
+    }
 
     void initServer();
+    void initBufferRing();
+    void initFixedFiles();
+    void initFixedBuffers();
+    // 启用注册文件时连接的 fd 是 ring 文件表中的下标，SQE 需要带 IOSQE_FIXED_FILE
+    void setFdFlags(io_uring_sqe* sqe) {
+        if (options_.fixed_files > 0) {
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+    }
+    char* fixedBuffer(int index) { return fixedBase_.get() + static_cast<size_t>(index) * options_.fixed_buf_size; }
+    void releaseFixedBuffer(ConnInfo& conn);
+    void shutdownConn(ConnInfo& conn);
+    void closeConn(int fd);
+    io_uring_sqe* getSqe();
     void submitAcceptEvent();
     void eventLoop();
     void processCompletion(io_uring_cqe* cqe);
-    void handleAccept(std::shared_ptr<ConnInfo> conn, int res);
-    void handleRead(std::shared_ptr<ConnInfo> conn, int res);
-    void handleWrite(std::shared_ptr<ConnInfo> conn, int res);
-    void submitReadEvent(std::shared_ptr<ConnInfo> conn);
-    void submitWriteEvent(std::shared_ptr<ConnInfo> conn, int length);
+    void handleAccept(io_uring_cqe* cqe);
+    void handleRead(ConnInfo& conn, io_uring_cqe* cqe);
+    void handleWrite(ConnInfo& conn, int res);
+    void handleValueSend(io_uring_cqe* cqe);
+    void processInput(ConnInfo& conn);
+    void submitReadEvent(ConnInfo& conn);
+    void submitReadIfIdle(ConnInfo& conn);
+    void submitWriteEvent(ConnInfo& conn);
+    void submitValueSend(ConnInfo& conn);
+    bool sendsZeroCopy(const ConnInfo& conn) const;
+    void pauseRead(ConnInfo& conn);
+    bool inputBacklogged(const ConnInfo& conn) const;
+    void recycleBuffer(unsigned short bid);
+    void releaseIdleBuffers(ConnInfo& conn);
+    void maybeClose(ConnInfo& conn);
+    ConnInfo& connFor(int fd);
+    void routeInput(ConnInfo& conn);
+    void executeLocal(ConnInfo& conn, size_t len);
+    void deferToDb(ConnInfo& conn);
+    void forwardRequest(ConnInfo& conn, size_t owner, size_t len, std::string_view key);
+    void flushForwards(ConnInfo& conn);
+    void sendMessage(size_t target, ShardMessage* msg, int event);
+    bool executeMessage(ShardMessage* msg);
+    void submitDbMessage(ShardMessage* msg, std::string_view key);
+    void replyFromDbThread(ShardMessage* msg);
+    void handleForward(ShardMessage* msg);
+    void handleReply(ShardMessage* msg);
+    void handleMessageFailure(ShardMessage* msg, int res);
+    std::unique_ptr<ShardMessage> acquireMessage();
+    size_t ownerOf(std::string_view key) const;
 
     unsigned short port_;
     int listenFd_;
     struct io_uring ring_;
     MsgHandler msgHandler_;
+    ProactorOptions options_;
+    std::vector<std::unique_ptr<ConnInfo>> conns_;  // 按 fd 下标
+    BufferPool bufferPool_;
+    io_uring_buf_ring* bufRing_ = nullptr;
+    std::unique_ptr<char, decltype(&free)> bufBase_{nullptr, &free};
+    int bufMask_ = 0;
+    int bufPending_ = 0;  // 本轮已还回但还没对内核可见的 ring 缓冲区数
+    std::unique_ptr<char, decltype(&free)> fixedBase_{nullptr, &free};
+    std::vector<int> freeFixedBufs_;        // 空闲的 fixed buffer 下标
+    size_t index_;                          // 本 ring 的下标
+    std::vector<ProactorServer*> peers_;    // 所有 ring，peers_[index_] == this
+    std::vector<std::unique_ptr<ShardMessage>> freeMessages_;
+    muduo::net::Buffer scratch_;            // 只执行输入缓冲区开头一部分请求时使用的副本
+    ProtocolState forwardState_;            // 执行转发请求用的协议状态
+    bool sendZeroCopy_ = true;              // 大值用 SEND_ZC 发送，内核不支持时退回普通 send
+    std::vector<std::unique_ptr<GatherSend>> freeGathers_;
 };
 
 // 类成员函数实现
 void ProactorServer::initServer() {
     listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    
+    int reuse = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    // 每个 ring 一个监听套接字，由内核分散新连接
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+
     sockaddr_in serverAddr{};
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -75,99 +265,773 @@ void ProactorServer::initServer() {
         LOG_SYSERR << "Bind failed on port " << port_;
         throw std::runtime_error("Port binding failed");
     }
-    listen(listenFd_, 10);
+    listen(listenFd_, SOMAXCONN);
+}
+
+void ProactorServer::initBufferRing() {
+    unsigned entries = options_.buf_ring_entries;
+    if (entries == 0 || (entries & (entries - 1)) != 0 || entries > 32768 || options_.buf_size == 0) {
+        LOG_ERROR << "buf_ring_entries must be a power of 2 in [1, 32768], fall back to single shot";
+        options_.multishot = false;
+        return;
+    }
+    int ret = 0;
+    bufRing_ = io_uring_setup_buf_ring(&ring_, entries, kBufferGroup, 0, &ret);
+    if (!bufRing_) {
+        LOG_ERROR << "io_uring_setup_buf_ring failed: " << strerror(-ret) << ", fall back to single shot";
+        options_.multishot = false;
+        return;
+    }
+    // aligned_alloc 要求大小是对齐的整数倍
+    size_t bytes = (static_cast<size_t>(entries) * options_.buf_size + 4095) & ~static_cast<size_t>(4095);
+    bufBase_.reset(static_cast<char*>(aligned_alloc(4096, bytes)));
+    bufMask_ = io_uring_buf_ring_mask(entries);
+    for (unsigned i = 0; i < entries; ++i) {
+        io_uring_buf_ring_add(bufRing_, bufBase_.get() + static_cast<size_t>(i) * options_.buf_size,
+                              options_.buf_size, static_cast<unsigned short>(i), bufMask_, static_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(bufRing_, static_cast<int>(entries));
+}
+
+// 注册一张空的文件表，direct accept 由内核分配空位；表大小受 RLIMIT_NOFILE 限制
+void ProactorServer::initFixedFiles() {
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    unsigned count = options_.fixed_files;
+    if (limit.rlim_cur < count) {
+        count = static_cast<unsigned>(limit.rlim_cur);
+    }
+    int ret = io_uring_register_files_sparse(&ring_, count);
+    if (ret < 0) {
+        LOG_ERROR << "io_uring_register_files_sparse failed: " << strerror(-ret) << ", use normal fds";
+        options_.fixed_files = 0;
+        return;
+    }
+    options_.fixed_files = count;
+}
+
+// 注册 fixed_buf_count 个 fixed_buf_size 字节的响应缓冲区；注册的内存计入 RLIMIT_MEMLOCK
+void ProactorServer::initFixedBuffers() {
+    unsigned count = options_.fixed_buf_count;
+    size_t size = options_.fixed_buf_size;
+    if (count > 16384 || size == 0 || size > (1u << 30)) {
+        LOG_ERROR << "fixed_buf_count must be <= 16384 and fixed_buf_size in (0, 1GB], disable fixed buffers";
+        options_.fixed_buf_count = 0;
+        return;
+    }
+    size_t bytes = (static_cast<size_t>(count) * size + 4095) & ~static_cast<size_t>(4095);
+    fixedBase_.reset(static_cast<char*>(aligned_alloc(4096, bytes)));
+    std::vector<iovec> iovecs(count);
+    for (unsigned i = 0; i < count; ++i) {
+        iovecs[i].iov_base = fixedBase_.get() + static_cast<size_t>(i) * size;
+        iovecs[i].iov_len = size;
+    }
+    int ret = io_uring_register_buffers(&ring_, iovecs.data(), count);
+    if (ret < 0) {
+        LOG_ERROR << "io_uring_register_buffers failed: " << strerror(-ret)
+                  << " (check RLIMIT_MEMLOCK), disable fixed buffers";
+        fixedBase_.reset();
+        options_.fixed_buf_count = 0;
+        return;
+    }
+    for (unsigned i = count; i > 0; --i) {
+        freeFixedBufs_.push_back(static_cast<int>(i - 1));
+    }
+}
+
+// SQ 满时先提交已有的 SQE 腾出位置
+io_uring_sqe* ProactorServer::getSqe() {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    while (sqe == nullptr) {
+        io_uring_submit(&ring_);
+        sqe = io_uring_get_sqe(&ring_);
+    }
+    return sqe;
+}
+
+ProactorServer::ConnInfo& ProactorServer::connFor(int fd) {
+    if (static_cast<size_t>(fd) >= conns_.size()) {
+        conns_.resize(static_cast<size_t>(fd) + 1);
+    }
+    if (!conns_[fd]) {
+        conns_[fd].reset(new ConnInfo());
+    }
+    return *conns_[fd];
 }
 
 void ProactorServer::submitAcceptEvent() {
-    auto* sqe = io_uring_get_sqe(&ring_);
-    auto conn = std::make_shared<ConnInfo>();
-    conn->fd = listenFd_;
-    conn->event = EVENT_ACCEPT;
-    io_uring_prep_accept(sqe, listenFd_, nullptr, nullptr, 0);
-    io_uring_sqe_set_data(sqe, new ConnPtr(conn));
-    io_uring_submit(&ring_);
+    auto* sqe = getSqe();
+    if (options_.fixed_files > 0) {
+        // 新连接直接放进注册文件表，CQE 的 res 是表中下标
+        if (options_.multishot) {
+            io_uring_prep_multishot_accept_direct(sqe, listenFd_, nullptr, nullptr, 0);
+        } else {
+            io_uring_prep_accept_direct(sqe, listenFd_, nullptr, nullptr, 0, IORING_FILE_INDEX_ALLOC);
+        }
+    } else if (options_.multishot) {
+        io_uring_prep_multishot_accept(sqe, listenFd_, nullptr, nullptr, 0);
+    } else {
+        io_uring_prep_accept(sqe, listenFd_, nullptr, nullptr, 0);
+    }
+    io_uring_sqe_set_data64(sqe, makeUserData(listenFd_, EVENT_ACCEPT));
 }
 
 void ProactorServer::eventLoop() {
     while (true) {
-        io_uring_submit(&ring_);
+        // 上一轮产生的所有 SQE 一次提交，并等待至少一个完成事件
+        io_uring_submit_and_wait(&ring_, 1);
         io_uring_cqe* cqe;
         unsigned head, count = 0;
-        
+
         io_uring_for_each_cqe(&ring_, head, cqe) {
             ++count;
             processCompletion(cqe);
         }
         io_uring_cq_advance(&ring_, count);
+        if (bufPending_ > 0) {
+            io_uring_buf_ring_advance(bufRing_, bufPending_);
+            bufPending_ = 0;
+        }
     }
 }
 
 void ProactorServer::processCompletion(io_uring_cqe* cqe) {
-    auto ptr = static_cast<ConnPtr*>(io_uring_cqe_get_data(cqe));
-    auto conn = *ptr;
-    delete ptr;
+    uint64_t data = io_uring_cqe_get_data64(cqe);
+    int fd = static_cast<int>(data >> 8);
+
+    ShardMessage* msg = reinterpret_cast<ShardMessage*>(static_cast<uintptr_t>(data >> 8));
 
-    switch (conn->event) {
-        case EVENT_ACCEPT: handleAccept(conn, cqe->res); break;
-        case EVENT_READ:   handleRead(conn, cqe->res);   break;
-        case EVENT_WRITE:  handleWrite(conn, cqe->res);  break;
+    switch (data & 0xff) {
+        case EVENT_ACCEPT:   handleAccept(cqe); break;
+        case EVENT_READ:     handleRead(connFor(fd), cqe); break;
+        case EVENT_WRITE:    handleWrite(connFor(fd), cqe->res); break;
+        case EVENT_FORWARD:  handleForward(msg); break;
+        case EVENT_REPLY:    handleReply(msg); break;
+        case EVENT_MSG_FAIL: handleMessageFailure(msg, cqe->res); break;
+        case EVENT_SEND_VALUE: handleValueSend(cqe); break;
+        case EVENT_IGNORE:
+            LOG_DEBUG << "shutdown/close of direct descriptor " << fd << " failed: " << strerror(-cqe->res);
+            break;
     }
 }
 
-void ProactorServer::handleAccept(std::shared_ptr<ConnInfo> conn, int res) {
-    if (res < 0) {
-        LOG_ERROR << "Accept failed: " << strerror(-res);
+void ProactorServer::handleAccept(io_uring_cqe* cqe) {
+    // multishot accept 被内核终止（如出错）时没有 IORING_CQE_F_MORE，需要重新提交
+    if (!options_.multishot || !(cqe->flags & IORING_CQE_F_MORE)) {
+        submitAcceptEvent();
+    }
+    if (cqe->res < 0) {
+        LOG_ERROR << "Accept failed: " << strerror(-cqe->res);
+        return;
+    }
+
+    ConnInfo& conn = connFor(cqe->res);
+    conn.fd = cqe->res;
+    conn.protocol.zerocopy = &conn.zerocopy;
+    submitReadEvent(conn);
+}
+
+void ProactorServer::submitReadEvent(ConnInfo& conn) {
+    auto* sqe = getSqe();
+    if (options_.multishot) {
+        // 不指定缓冲区，由内核从 buffer ring 中选取
+        io_uring_prep_recv_multishot(sqe, conn.fd, nullptr, 0, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+        sqe->buf_group = kBufferGroup;
+    } else {
+        if (!conn.input) {
+            conn.input = bufferPool_.acquire();
+        }
+        conn.input->ensureWritableBytes(kReadSize);
+        io_uring_prep_recv(sqe, conn.fd, conn.input->beginWrite(), conn.input->writableBytes(), 0);
+    }
+    setFdFlags(sqe);
+    io_uring_sqe_set_data64(sqe, makeUserData(conn.fd, EVENT_READ));
+    conn.reading = true;
+}
+
+// 单次 recv 模式下 recv 直接写入输入缓冲区，发送中或还有转发中的请求时
+// （输入缓冲区中可能还有等待执行的请求）不挂 recv；multishot 模式下输入积压时同样不挂
+void ProactorServer::submitReadIfIdle(ConnInfo& conn) {
+    if (conn.reading || conn.closing || conn.fd < 0) {
+        return;
+    }
+    if (!options_.multishot && (conn.writing || !conn.forwards.empty())) {
+        return;
+    }
+    if (inputBacklogged(conn)) {
+        return;
+    }
+    submitReadEvent(conn);
+}
+
+// 发送挂起（套接字不可写）或等待回源期间请求只进不出
+bool ProactorServer::inputBacklogged(const ConnInfo& conn) const {
+    return (conn.writing || conn.db_pending) && conn.input && conn.input->readableBytes() >= kMaxPendingInput;
+}
+
+// 取消挂着的 multishot recv，recv 以 -ECANCELED 结束后 reading 清零
+void ProactorServer::pauseRead(ConnInfo& conn) {
+    auto* sqe = getSqe();
+    io_uring_prep_cancel64(sqe, makeUserData(conn.fd, EVENT_READ), 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    io_uring_sqe_set_data64(sqe, makeUserData(conn.fd, EVENT_IGNORE));
+    conn.pausing = true;
+}
+
+void ProactorServer::recycleBuffer(unsigned short bid) {
+    io_uring_buf_ring_add(bufRing_, bufBase_.get() + static_cast<size_t>(bid) * options_.buf_size,
+                          options_.buf_size, bid, bufMask_, bufPending_);
+    ++bufPending_;
+}
+
+void ProactorServer::handleRead(ConnInfo& conn, io_uring_cqe* cqe) {
+    int res = cqe->res;
+    if (!options_.multishot || !(cqe->flags & IORING_CQE_F_MORE)) {
+        conn.reading = false;
+        conn.pausing = false;
+    }
+    if (res > 0) {
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            // 拷进连接的输入缓冲区后立刻把 ring 缓冲区还回去
+            unsigned short bid = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            if (!conn.input) {
+                conn.input = bufferPool_.acquire();
+            }
+            conn.input->append(bufBase_.get() + static_cast<size_t>(bid) * options_.buf_size, res);
+            recycleBuffer(bid);
+        } else {
+            conn.input->hasWritten(res);
+        }
+        // 发送中的连接先攒着，发送完成后再处理；积压太多时暂停接收
+        if (!conn.writing && !conn.closing) {
+            processInput(conn);
+        }
+        if (conn.reading && !conn.pausing && inputBacklogged(conn)) {
+            pauseRead(conn);
+        }
+    } else if (res == -ECANCELED) {
+        // 输入积压时主动取消的 recv，发送完成后重新挂上
+    } else if (res == -ENOBUFS) {
+        // buffer ring 暂时用完，本轮还回的缓冲区生效后重新挂 recv
+        LOG_DEBUG << "provided buffer ring exhausted";
+    } else {
+        conn.closing = true;  // 对端关闭或出错
+    }
+    submitReadIfIdle(conn);
+    maybeClose(conn);
+}
+
+// 一次读取可能包含多个请求或半个请求，所有响应合并为一次发送
+void ProactorServer::processInput(ConnInfo& conn) {
+    if (!conn.output) {
+        conn.output = bufferPool_.acquire();
+    }
+    flushForwards(conn);
+    // 单次 recv 模式下输入缓冲区可能正被内核写入；回源中的连接等响应回来后再继续
+    if (conn.input && !(conn.reading && !options_.multishot) && !conn.db_pending) {
+        if (peers_.size() <= 1 && conn.forwards.empty()) {
+            if (!msgHandler_(conn.input.get(), conn.output.get(), &conn.protocol)) {
+                conn.closing = true;
+            } else if (conn.protocol.db_deferred) {
+                deferToDb(conn);
+            }
+        } else {
+            routeInput(conn);
+        }
+    }
+    if (conn.hasOutput()) {
+        submitWriteEvent(conn);
+    } else if (conn.closing && conn.reading && conn.forwards.empty()) {
+        shutdownConn(conn);  // 让挂着的 multishot recv 结束，之后再关闭
+    }
+    releaseIdleBuffers(conn);
+}
+
+void ProactorServer::shutdownConn(ConnInfo& conn) {
+    if (options_.fixed_files == 0) {
+        ::shutdown(conn.fd, SHUT_RDWR);
+        return;
+    }
+    auto* sqe = getSqe();
+    io_uring_prep_shutdown(sqe, conn.fd, SHUT_RDWR);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE | IOSQE_CQE_SKIP_SUCCESS);
+    io_uring_sqe_set_data64(sqe, makeUserData(conn.fd, EVENT_IGNORE));
+}
+
+// 注册文件用 close_direct 从文件表中移除，之后该下标才会被 direct accept 复用
+void ProactorServer::closeConn(int fd) {
+    if (options_.fixed_files == 0) {
+        close(fd);
         return;
     }
-    
-    auto clientConn = std::make_shared<ConnInfo>();
-    clientConn->fd = res;
-    clientConn->event = EVENT_READ;
-    submitReadEvent(clientConn);
-    submitAcceptEvent();
+    auto* sqe = getSqe();
+    io_uring_prep_close_direct(sqe, static_cast<unsigned>(fd));
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    io_uring_sqe_set_data64(sqe, makeUserData(fd, EVENT_IGNORE));
 }
 
-void ProactorServer::submitReadEvent(std::shared_ptr<ConnInfo> conn) {
-    auto* sqe = io_uring_get_sqe(&ring_);
-    io_uring_prep_recv(sqe, conn->fd, conn->buffer, sizeof(conn->buffer), 0);
-    io_uring_sqe_set_data(sqe, new ConnPtr(conn));
-    io_uring_submit(&ring_);
+size_t ProactorServer::ownerOf(std::string_view key) const {
+    return KVStore::getInstance().shardIndexOf(key) % peers_.size();
 }
 
-void ProactorServer::handleRead(std::shared_ptr<ConnInfo> conn, int res) {
-    if (res <= 0) {
-        close(conn->fd);
+// 按请求逐条路由：开头连续的本地请求一起执行，遇到属于其他 ring 的请求时转发；
+// 多键命令等需要等之前转发的请求都完成后再执行，保证同一连接上的请求按顺序生效
+void ProactorServer::routeInput(ConnInfo& conn) {
+    muduo::net::Buffer* input = conn.input.get();
+    while (!conn.closing && !conn.db_pending && input->readableBytes() > 0) {
+        const char* data = input->peek();
+        size_t len = input->readableBytes();
+        size_t local = 0;
+        size_t owner = index_;
+        RouteKind kind = kRouteIncomplete;
+        RequestRoute route;
+        while (local < len) {
+            route = RequestRoute();
+            kind = routeRequest(data + local, len - local, &conn.protocol, &route);
+            if (kind == kRouteIncomplete || (kind == kRouteBarrier && !conn.forwards.empty())) {
+                break;
+            }
+            owner = kind == kRouteKey ? ownerOf(route.key) : index_;
+            if (owner != index_) {
+                break;
+            }
+            local += route.length;
+        }
+        if (local > 0) {
+            executeLocal(conn, local);
+            continue;
+        }
+        if (kind == kRouteIncomplete || kind == kRouteBarrier ||
+            conn.forwards.size() >= kMaxForwardsPerConn) {
+            break;
+        }
+        forwardRequest(conn, owner, route.length, route.key);
+    }
+}
+
+// 执行输入缓冲区开头 len 字节中的请求；前面还有未完成的转发时响应先排队
+void ProactorServer::executeLocal(ConnInfo& conn, size_t len) {
+    muduo::net::Buffer* output = conn.output.get();
+    ZeroCopyRefs* zc = conn.protocol.zerocopy;
+    if (!conn.forwards.empty()) {
+        if (!conn.forwards.back()->local) {
+            std::unique_ptr<ShardMessage> msg = acquireMessage();
+            msg->local = true;
+            msg->done = true;
+            conn.forwards.push_back(std::move(msg));
+        }
+        output = &conn.forwards.back()->response;
+        if (zc != nullptr) {
+            conn.protocol.zerocopy = &conn.forwards.back()->refs;
+        }
+    }
+    bool keep_open;
+    if (len == conn.input->readableBytes()) {
+        keep_open = msgHandler_(conn.input.get(), output, &conn.protocol);
+    } else {
+        scratch_.append(conn.input->peek(), len);
+        keep_open = msgHandler_(&scratch_, output, &conn.protocol);
+        conn.input->retrieve(len - scratch_.readableBytes());  // 停在需要回源的请求上时，它和之后的请求留在 input 中
+        scratch_.retrieveAll();
+    }
+    conn.protocol.zerocopy = zc;
+    if (!keep_open) {
+        conn.closing = true;
         return;
     }
+    if (conn.protocol.db_deferred) {
+        deferToDb(conn);
+    }
+}
 
-    conn->event = EVENT_WRITE;
-    memset(conn->response, 0, sizeof(conn->response));
-    int respLen = msgHandler_(conn->buffer, res, conn->response);
-    submitWriteEvent(conn, respLen);
+// 停在需要回源数据库的请求上：把它交给 DB 线程池，之后的请求留在 input 中，
+// 等它的响应回来后再执行，保证同一连接上的请求按顺序生效（如 GET 未命中后紧跟的 SET）
+void ProactorServer::deferToDb(ConnInfo& conn) {
+    conn.protocol.db_deferred = false;
+    RequestRoute route;
+    routeRequest(conn.input->peek(), conn.input->readableBytes(), &conn.protocol, &route);
+    forwardRequest(conn, kDbPool, route.length, route.key);
+    conn.db_pending = true;
 }
 
-void ProactorServer::submitWriteEvent(std::shared_ptr<ConnInfo> conn, int length) {
-    auto* sqe = io_uring_get_sqe(&ring_);
-    io_uring_prep_send(sqe, conn->fd, conn->response, length, 0);
-    io_uring_sqe_set_data(sqe, new ConnPtr(conn));
-    io_uring_submit(&ring_);
+void ProactorServer::forwardRequest(ConnInfo& conn, size_t owner, size_t len, std::string_view key) {
+    std::unique_ptr<ShardMessage> msg = acquireMessage();
+    msg->conn = &conn;
+    msg->origin = index_;
+    msg->resp_version = conn.protocol.resp.version;
+    msg->zerocopy = conn.protocol.zerocopy != nullptr;
+    msg->request.append(conn.input->peek(), len);
+    if (owner == kDbPool) {
+        msg->db = true;
+        submitDbMessage(msg.get(), key);
+    } else {
+        sendMessage(owner, msg.get(), EVENT_FORWARD);
+    }
+    conn.input->retrieve(len);  // key 指向 input，用完再取走
+    conn.forwards.push_back(std::move(msg));
+}
+
+// 把队首已就绪的响应按顺序写入 output
+void ProactorServer::flushForwards(ConnInfo& conn) {
+    while (!conn.forwards.empty() && conn.forwards.front()->done) {
+        std::unique_ptr<ShardMessage> msg = std::move(conn.forwards.front());
+        conn.forwards.pop_front();
+        conn.zerocopy.splice(&msg->refs, conn.output->readableBytes());
+        conn.output->append(msg->response.peek(), msg->response.readableBytes());
+        msg->request.retrieveAll();
+        msg->response.retrieveAll();
+        msg->local = false;
+        msg->done = false;
+        msg->zerocopy = false;
+        msg->db = false;
+        freeMessages_.push_back(std::move(msg));
+    }
+}
+
+std::unique_ptr<ProactorServer::ShardMessage> ProactorServer::acquireMessage() {
+    if (freeMessages_.empty()) {
+        return std::unique_ptr<ShardMessage>(new ShardMessage());
+    }
+    std::unique_ptr<ShardMessage> msg = std::move(freeMessages_.back());
+    freeMessages_.pop_back();
+    return msg;
+}
+
+// 用 MSG_RING 在目标 ring 上产生一个 CQE，user_data 携带消息指针；
+// 投递成功时本 ring 不产生 CQE，失败时收到 EVENT_MSG_FAIL
+void ProactorServer::sendMessage(size_t target, ShardMessage* msg, int event) {
+    auto* sqe = getSqe();
+    io_uring_prep_msg_ring(sqe, peers_[target]->ring_.ring_fd, 0, makeUserData(msg, event), 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    io_uring_sqe_set_data64(sqe, makeUserData(msg, EVENT_MSG_FAIL));
+}
+
+// 用发起方连接的协议状态执行转发的请求，大值引用随响应一起送回发起方；
+// 需要回源数据库时交给 DB 线程池，由它送回响应，返回 false
+bool ProactorServer::executeMessage(ShardMessage* msg) {
+    forwardState_.resp.version = msg->resp_version;
+    forwardState_.zerocopy = msg->zerocopy ? &msg->refs : nullptr;
+    msgHandler_(&msg->request, &msg->response, &forwardState_);
+    if (!forwardState_.db_deferred) {
+        return true;
+    }
+    forwardState_.db_deferred = false;
+    RequestRoute route;
+    routeRequest(msg->request.peek(), msg->request.readableBytes(), &forwardState_, &route);
+    submitDbMessage(msg, route.key);
+    return false;
+}
+
+// 在 DB 线程池中执行消息中的请求，分片仍有锁保护
+void ProactorServer::submitDbMessage(ShardMessage* msg, std::string_view key) {
+    dbCacheSubmit(key, [this, msg]() {
+        ProtocolState state;
+        state.resp.version = msg->resp_version;
+        state.zerocopy = msg->zerocopy ? &msg->refs : nullptr;
+        msgHandler_(&msg->request, &msg->response, &state);
+        replyFromDbThread(msg);
+    });
+}
+
+// DB 线程没有自己的事件循环：每个 DB 线程建一个只用来提交 MSG_RING 的小 ring，
+// 把执行完的消息作为 EVENT_REPLY 投递给发起方 ring；目标 CQ 满等失败时稍后重试
+void ProactorServer::replyFromDbThread(ShardMessage* msg) {
+    thread_local io_uring t_ring;
+    thread_local bool t_ready = io_uring_queue_init(8, &t_ring, 0) == 0;
+    if (!t_ready) {
+        LOG_ERROR << "io_uring for db replies unavailable, connection stalls";
+        return;
+    }
+    int target = peers_[msg->origin]->ring_.ring_fd;
+    while (true) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&t_ring);
+        io_uring_prep_msg_ring(sqe, target, 0, makeUserData(msg, EVENT_REPLY), 0);
+        io_uring_cqe* cqe = nullptr;
+        int res = io_uring_submit(&t_ring);
+        if (res >= 0) {
+            res = io_uring_wait_cqe(&t_ring, &cqe);
+        }
+        if (res >= 0) {
+            res = cqe->res;
+            io_uring_cqe_seen(&t_ring, cqe);
+        }
+        if (res >= 0) {
+            return;
+        }
+        LOG_ERROR << "db reply to ring " << msg->origin << " failed: " << strerror(-res) << ", retry";
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 执行其他 ring 转发来的请求，把响应送回发起方
+void ProactorServer::handleForward(ShardMessage* msg) {
+    if (executeMessage(msg)) {
+        sendMessage(msg->origin, msg, EVENT_REPLY);
+    }
+}
+
+void ProactorServer::handleReply(ShardMessage* msg) {
+    msg->done = true;
+    ConnInfo& conn = *msg->conn;
+    if (msg->db) {
+        conn.db_pending = false;
+    }
+    // 发送中的连接等发送完成后再写入 output
+    if (!conn.writing) {
+        processInput(conn);
+    }
+    submitReadIfIdle(conn);
+    maybeClose(conn);
+}
+
+void ProactorServer::handleMessageFailure(ShardMessage* msg, int res) {
+    if (msg->origin == index_) {
+        // 转发失败（如目标 CQ 溢出）：分片仍有锁保护，直接在本 ring 执行
+        LOG_WARN << "forward to ring failed: " << strerror(-res) << ", execute locally";
+        if (executeMessage(msg)) {
+            handleReply(msg);
+        }
+    } else {
+        LOG_ERROR << "reply to ring " << msg->origin << " failed: " << strerror(-res) << ", retry";
+        sendMessage(msg->origin, msg, EVENT_REPLY);
+    }
+}
+
+// 输出链按顺序发送：超过零拷贝阈值的值单独用 SEND_ZC 发送，其余的缓冲区片段和值一次聚集发送
+void ProactorServer::submitWriteEvent(ConnInfo& conn) {
+    if (conn.fixedBuf < 0 && conn.zerocopy.atValue() && sendsZeroCopy(conn)) {
+        submitValueSend(conn);
+        return;
+    }
+    // 只有缓冲区时，放得下的响应拷进空闲的 fixed buffer 发送，放不下或没有空闲的直接发送 output
+    if (conn.fixedBuf < 0 && conn.zerocopy.empty() && !freeFixedBufs_.empty() &&
+        conn.output->readableBytes() <= options_.fixed_buf_size) {
+        conn.fixedBuf = freeFixedBufs_.back();
+        freeFixedBufs_.pop_back();
+        conn.fixedLen = conn.output->readableBytes();
+        conn.fixedSent = 0;
+        memcpy(fixedBuffer(conn.fixedBuf), conn.output->peek(), conn.fixedLen);
+        conn.output->retrieveAll();
+    }
+    auto* sqe = getSqe();
+    if (conn.fixedBuf >= 0) {
+        io_uring_prep_write_fixed(sqe, conn.fd, fixedBuffer(conn.fixedBuf) + conn.fixedSent,
+                                  static_cast<unsigned>(conn.fixedLen - conn.fixedSent), 0, conn.fixedBuf);
+    } else if (conn.zerocopy.empty()) {
+        io_uring_prep_send(sqe, conn.fd, conn.output->peek(), conn.output->readableBytes(), 0);
+    } else {
+        if (freeGathers_.empty()) {
+            conn.gather.reset(new GatherSend);
+        } else {
+            conn.gather = std::move(freeGathers_.back());
+            freeGathers_.pop_back();
+        }
+        GatherSend* gather = conn.gather.get();
+        memset(&gather->msg, 0, sizeof(gather->msg));
+        gather->msg.msg_iov = gather->iov;
+        gather->msg.msg_iovlen = conn.zerocopy.gather(*conn.output, gather->iov, kMaxIov,
+                                                      sendZeroCopy_ ? options_.zerocopy_threshold : 0);
+        io_uring_prep_sendmsg(sqe, conn.fd, &gather->msg, 0);
+    }
+    setFdFlags(sqe);
+    io_uring_sqe_set_data64(sqe, makeUserData(conn.fd, EVENT_WRITE));
+    conn.writing = true;
 }
 
-void ProactorServer::handleWrite(std::shared_ptr<ConnInfo> conn, int res) {
+bool ProactorServer::sendsZeroCopy(const ConnInfo& conn) const {
+    return sendZeroCopy_ && options_.zerocopy_threshold > 0 &&
+           conn.zerocopy.frontOwner()->size() >= options_.zerocopy_threshold;
+}
+
+// 直接从存储发送队首的大值。SEND_ZC 先产生发送结果的 CQE（带 IORING_CQE_F_MORE），
+// 内核不再引用这段内存后再产生一个 IORING_CQE_F_NOTIF 的通知 CQE，ValueSend 到那时才释放
+void ProactorServer::submitValueSend(ConnInfo& conn) {
+    std::string_view value = conn.zerocopy.frontValue();
+    ValueSend* send = new ValueSend;
+    send->fd = conn.fd;
+    send->value = conn.zerocopy.frontOwner();
+    auto* sqe = getSqe();
+    io_uring_prep_send_zc(sqe, conn.fd, value.data(), value.size(), 0, 0);
+    setFdFlags(sqe);
+    io_uring_sqe_set_data64(sqe, makeUserData(send, EVENT_SEND_VALUE));
+    conn.writing = true;
+}
+
+void ProactorServer::handleValueSend(io_uring_cqe* cqe) {
+    ValueSend* send = reinterpret_cast<ValueSend*>(static_cast<uintptr_t>(io_uring_cqe_get_data64(cqe) >> 8));
+    if (cqe->flags & IORING_CQE_F_NOTIF) {
+        delete send;  // 通知 CQE 不关联连接，连接可能已经关闭
+        return;
+    }
+    int fd = send->fd;
+    int res = cqe->res;
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        delete send;  // SEND_ZC 失败，没有后续通知
+    }
+    if ((res == -EOPNOTSUPP || res == -EINVAL) && sendZeroCopy_) {
+        // 内核或套接字不支持 SEND_ZC，之后大值也走聚集发送，本次重新发送
+        LOG_WARN << "send_zc unsupported: " << strerror(-res) << ", fall back to sendmsg";
+        sendZeroCopy_ = false;
+        ConnInfo& conn = connFor(fd);
+        conn.writing = false;
+        submitWriteEvent(conn);
+        return;
+    }
+    handleWrite(connFor(fd), res);
+}
+
+void ProactorServer::releaseFixedBuffer(ConnInfo& conn) {
+    if (conn.fixedBuf >= 0) {
+        freeFixedBufs_.push_back(conn.fixedBuf);
+        conn.fixedBuf = -1;
+    }
+}
+
+void ProactorServer::handleWrite(ConnInfo& conn, int res) {
+    conn.writing = false;
+    if (conn.gather) {
+        freeGathers_.push_back(std::move(conn.gather));
+    }
     if (res < 0) {
-        close(conn->fd);
+        releaseFixedBuffer(conn);
+        conn.closing = true;
+        if (conn.reading) {
+            shutdownConn(conn);
+        }
+        maybeClose(conn);
         return;
     }
-    conn->event = EVENT_READ;
-    memset(conn->buffer, 0, sizeof(conn->buffer));
-    submitReadEvent(conn);
+    if (conn.fixedBuf >= 0) {
+        conn.fixedSent += static_cast<size_t>(res);
+        if (conn.fixedSent < conn.fixedLen) {
+            submitWriteEvent(conn);  // 部分发送，继续发送 fixed buffer 中剩余的数据
+            return;
+        }
+        releaseFixedBuffer(conn);
+    } else {
+        conn.zerocopy.consume(conn.output.get(), static_cast<size_t>(res));
+    }
+    if (conn.hasOutput()) {
+        submitWriteEvent(conn);  // 部分发送，继续发送剩余数据
+        return;
+    }
+    if (conn.closing && conn.forwards.empty()) {
+        if (conn.reading) {
+            shutdownConn(conn);
+        }
+        maybeClose(conn);
+        return;
+    }
+    // 发送期间到达的请求、已就绪的转发响应、以及等待转发完成的请求
+    if ((!conn.forwards.empty() && conn.forwards.front()->done) ||
+        (conn.input && conn.input->readableBytes() > 0 && !conn.closing &&
+         (options_.multishot || peers_.size() > 1))) {
+        processInput(conn);
+    }
+    submitReadIfIdle(conn);
+    releaseIdleBuffers(conn);
+}
+
+// 没有待处理的请求和待发送的响应时把缓冲区还给池；单次 recv 模式下输入缓冲区可能正被内核写入
+void ProactorServer::releaseIdleBuffers(ConnInfo& conn) {
+    if (conn.writing) {
+        return;
+    }
+    if (conn.output && !conn.hasOutput()) {
+        bufferPool_.release(std::move(conn.output));
+    }
+    if (conn.input && conn.input->readableBytes() == 0 && !(conn.reading && !options_.multishot)) {
+        bufferPool_.release(std::move(conn.input));
+    }
+}
+
+// 没有请求挂在内核中、也没有转发到其他 ring 的请求时才真正关闭，fd 被复用后不会收到旧连接的 CQE；
+// 只在事件处理的最后调用
+void ProactorServer::maybeClose(ConnInfo& conn) {
+    if (!conn.closing || conn.reading || conn.writing || !conn.forwards.empty()) {
+        return;
+    }
+    closeConn(conn.fd);
+    releaseFixedBuffer(conn);
+    bufferPool_.release(std::move(conn.input));
+    bufferPool_.release(std::move(conn.output));
+    conns_[conn.fd].reset();  // 关闭后释放连接状态，conn 不再可用
+}
+
+namespace {
+
+// 当前线程可以运行的 CPU 列表
+std::vector<int> availableCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+void pinToCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        LOG_ERROR << "pin to cpu " << cpu << " failed: " << strerror(ret);
+    }
 }
 
-void runProactorServer() {
+}  // namespace
+
+void runProactorServer(const ProactorOptions& options) {
+    ProactorOptions opts = options;
+    std::vector<int> cpus = availableCpus();
+    if (opts.rings <= 0) {
+        opts.rings = cpus.empty() ? 1 : static_cast<int>(cpus.size());
+    }
     try {
-        ProactorServer server(2000, commandHandler);
-        server.run();
+        std::vector<std::unique_ptr<ProactorServer>> servers;
+        std::vector<ProactorServer*> peers;
+        for (int i = 0; i < opts.rings; ++i) {
+            servers.emplace_back(new ProactorServer(2000, handleInput, opts, static_cast<size_t>(i)));
+            peers.push_back(servers.back().get());
+        }
+        if (opts.rings == 1) {
+            servers[0]->run();
+            return;
+        }
+        size_t shards = KVStore::getInstance().shardCount();
+        if (shards % static_cast<size_t>(opts.rings) != 0) {
+            LOG_WARN << "shard_count " << shards << " is not a multiple of proactor_rings " << opts.rings
+                     << ", shards are unevenly owned";
+        }
+        // 所有 ring 都拿到完整的 peers 后才开始运行，之后 peers 只读
+        for (auto& server : servers) {
+            server->setPeers(peers);
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < opts.rings; ++i) {
+            threads.emplace_back([&, i]() {
+                if (opts.pin_cpu && !cpus.empty()) {
+                    pinToCpu(cpus[i % cpus.size()]);
+                }
+                servers[i]->run();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
     } catch (const std::exception& e) {
         LOG_ERROR << "Proactor server failed: " << e.what();
     }
-}
\ No newline at end of file
+}
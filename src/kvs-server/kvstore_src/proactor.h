@@ -8,18 +8,22 @@
 #include <memory>
 #include <vector>
 #include "muduo/base/Logging.h"
+#include "muduo/net/Buffer.h"
+#include "command_handler.h"
 
 // 前置声明需要与实现中的ConnInfo结构一致
 struct ConnInfo {
     int fd;
     int event;
-    char buffer[1024];
-    char response[1024];
+    muduo::net::Buffer input;
+    muduo::net::Buffer output;
+    bool closing = false;
+    ProtocolState protocol;
 };
 
 class ProactorServer {
 public:
-    using MsgHandler = std::function<int(char*, int, char*)>;
+    using MsgHandler = std::function<bool(muduo::net::Buffer*, muduo::net::Buffer*, ProtocolState*)>;
     
     ProactorServer(unsigned short port, MsgHandler handler);
     ~ProactorServer();
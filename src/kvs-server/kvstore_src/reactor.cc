@@ -2,11 +2,14 @@
 #include <stdio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <linux/errqueue.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <functional>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include <queue>
@@ -15,23 +18,53 @@
 #include <thread>
 #include <atomic>
 #include "command_handler.h" 
+#include "muduo/net/Buffer.h"
+#include "buffer_pool.h"
+#include "server.h"
 
-// 假设的 conn 结构体定义
+// 连接状态。缓冲区在第一次读到数据时才从池中取出，请求处理完、响应发完后归还，
+// 大值引用队列为空时也不占堆内存，空闲连接只占用这个结构体本身
 struct Conn {
-    int fd;
-    char rbuffer[1024];
-    int rlength;
-    char wbuffer[1024];
-    int wlength;
+    int fd = -1;
+    std::unique_ptr<muduo::net::Buffer> input;   // 已读到但还没处理完的请求（可能包含半个帧）
+    std::unique_ptr<muduo::net::Buffer> output;  // 待发送的响应，一次读取产生的所有响应合并发送
+    bool closing = false;       // 协议错误，发送完剩余响应后关闭
+    ProtocolState protocol;     // 连接级的协议状态（如 RESP 版本）
+    ZeroCopyRefs zerocopy;      // output 中的大值引用
+    // MSG_ZEROCOPY 发出、内核还在引用的大值，按发送序号排列，收到错误队列中的完成通知后释放
+    FifoQueue<std::pair<uint32_t, SharedValue>> zc_inflight;
+    uint32_t zc_next = 0;       // 下一次 MSG_ZEROCOPY 发送的序号，与内核按连接计数的序号一致
+    bool zc_closing = false;    // 已经关闭，但还有大值在内核中，收到全部完成通知后再 close
+    bool zc_enabled = false;    // 套接字开启了 SO_ZEROCOPY
     struct {
         std::function<int(int)> recv_callback;
     } r_action;
     std::function<int(int)> send_callback;
 };
 
-#define CONNECTION_SIZE 1024
 #define MAX_PORTS 1
-#define BUFFER_LENGTH 1024
+#define MAX_EVENTS 1024
+#define MAX_IOV 64   // 一次聚集发送最多的段数
+
+// 按 fd 下标的连接表，分块分配，fd 增大时追加新块；已分配的块不会移动，
+// 工作线程持有的 Conn* 在表增长时仍然有效。只在主线程中增长。
+class ConnTable {
+public:
+    static const size_t kChunkSize = 4096;
+
+    Conn& operator[](int fd) {
+        size_t chunk = static_cast<size_t>(fd) / kChunkSize;
+        while (chunks_.size() <= chunk) {
+            chunks_.emplace_back(new Conn[kChunkSize]);
+        }
+        return chunks_[chunk][static_cast<size_t>(fd) % kChunkSize];
+    }
+
+    size_t capacity() const { return chunks_.size() * kChunkSize; }
+
+private:
+    std::vector<std::unique_ptr<Conn[]>> chunks_;
+};
 
 // 计算时间差的函数
 int timeSubMs(const timeval& tv1, const timeval& tv2) {
@@ -93,10 +126,12 @@ class ReactorServer {
 private:
     int epfd;
     timeval begin;
-    std::vector<Conn> conn_list;
-    std::function<int(char*, int, char*)> kvs_handler;
+    ConnTable conn_list;
+    BufferPool buffer_pool;
+    std::function<bool(muduo::net::Buffer*, muduo::net::Buffer*, ProtocolState*)> kvs_handler;
     ThreadPool thread_pool;
     std::mutex epoll_mutex;
+    size_t zerocopy_threshold;  // 不小于该大小的值用 MSG_ZEROCOPY 发送，0 表示关闭
 
     // 设置事件
     int setEvent(int fd, int event, bool flag) {
@@ -122,15 +157,92 @@ private:
         conn_list[fd].r_action.recv_callback = [this](int fd) { return this->recvCb(fd); };
         conn_list[fd].send_callback = [this](int fd) { return this->sendCb(fd); };
 
-        memset(conn_list[fd].rbuffer, 0, BUFFER_LENGTH);
-        conn_list[fd].rlength = 0;
-        memset(conn_list[fd].wbuffer, 0, BUFFER_LENGTH);
-        conn_list[fd].wlength = 0;
+        conn_list[fd].closing = false;
+        conn_list[fd].protocol = ProtocolState();
+        conn_list[fd].protocol.zerocopy = &conn_list[fd].zerocopy;
+        conn_list[fd].zc_next = 0;
+        int on = 1;
+        // 开启失败（如老内核）时大值也走聚集发送
+        conn_list[fd].zc_enabled = zerocopy_threshold > 0 &&
+                                   setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
 
         setEvent(fd, event, true);
         return 0;
     }
 
+    // 关闭连接并清空缓冲区。还有 MSG_ZEROCOPY 发出的大值在内核中时 fd 先不关闭，
+    // 只用边沿触发等待错误队列上的完成通知（不会因为 HUP 反复就绪），值释放完后再关闭
+    void closeConn(int fd) {
+        Conn& conn = conn_list[fd];
+        releaseBuffers(conn);
+        conn.zerocopy.clear();
+        conn.closing = false;
+        conn.protocol = ProtocolState();
+        drainZeroCopy(conn);
+        if (!conn.zc_inflight.empty()) {
+            conn.zc_closing = true;
+            setEvent(fd, EPOLLET, false);
+            return;
+        }
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+    }
+
+    // 读取错误队列中的零拷贝完成通知，每个通知是一段连续的发送序号 [ee_info, ee_data]。
+    // 回环连接上内核会退化为拷贝（ee_code 带 SO_EE_CODE_ZEROCOPY_COPIED），同样只是释放引用
+    void drainZeroCopy(Conn& conn) {
+        char control[128];
+        while (!conn.zc_inflight.empty()) {
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(conn.fd, &msg, MSG_ERRQUEUE) < 0) {
+                break;
+            }
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                               (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if (!recverr) {
+                    continue;
+                }
+                sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if (err.ee_origin == SO_EE_ORIGIN_ZEROCOPY && err.ee_errno == 0) {
+                    releaseZeroCopy(conn, err.ee_info, err.ee_data);
+                }
+            }
+        }
+    }
+
+    // 释放序号在 [lo, hi] 内的大值（序号按 32 位回绕比较），通知通常按顺序到达
+    void releaseZeroCopy(Conn& conn, uint32_t lo, uint32_t hi) {
+        auto& inflight = conn.zc_inflight;
+        while (!inflight.empty() && inflight.front().first - lo <= hi - lo) {
+            inflight.pop_front();
+        }
+        for (auto it = inflight.begin(); it != inflight.end();) {
+            it = it->first - lo <= hi - lo ? inflight.erase(it) : it + 1;
+        }
+    }
+
+    // 错误事件：零拷贝完成通知，延迟关闭的连接在全部通知到达后真正关闭
+    void errorCb(int fd) {
+        Conn& conn = conn_list[fd];
+        drainZeroCopy(conn);
+        if (conn.zc_closing && conn.zc_inflight.empty()) {
+            conn.zc_closing = false;
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+        }
+    }
+
+    // 请求处理完、响应发完后把缓冲区还给池
+    void releaseBuffers(Conn& conn) {
+        buffer_pool.release(std::move(conn.input));
+        buffer_pool.release(std::move(conn.output));
+    }
+
     // 接受新连接回调
     int acceptCb(int fd) {
         sockaddr_in clientaddr;
@@ -152,53 +264,125 @@ private:
         return 0;
     }
 
-    // 接收数据回调
+    // 接收数据回调：数据追加到连接的输入缓冲区，可能包含多个请求或半个请求
     int recvCb(int fd) {
-        memset(conn_list[fd].rbuffer, 0, BUFFER_LENGTH);
-        int count = recv(fd, conn_list[fd].rbuffer, BUFFER_LENGTH, 0);
+        Conn& conn = conn_list[fd];
+        if (!conn.input) {
+            conn.input = buffer_pool.acquire();
+            conn.output = buffer_pool.acquire();
+        }
+        int saved_errno = 0;
+        ssize_t count = conn.input->readFd(fd, &saved_errno);
         if (count == 0) {
-            close(fd);
-            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+            closeConn(fd);
             return 0;
         } else if (count < 0) {
-            printf("count: %d, errno: %d, %s\n", count, errno, strerror(errno));
-            close(fd);
-            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+            printf("count: %zd, errno: %d, %s\n", count, saved_errno, strerror(saved_errno));
+            closeConn(fd);
             return 0;
         }
 
-        conn_list[fd].rlength = count;
-
         if (kvs_handler) {
+            // 处理期间不再监听该连接，避免主线程和工作线程同时访问缓冲区
+            setEvent(fd, 0, false);
             // 将业务处理任务放入线程池
-            thread_pool.enqueue([this, fd] {
-                int wlength = kvs_handler(
-                    conn_list[fd].rbuffer,  // 输入数据
-                    conn_list[fd].rlength,  // 输入数据长度
-                    conn_list[fd].wbuffer   // 输出响应缓冲区
-                );
-                conn_list[fd].wlength = wlength;
-                // 唤醒主线程处理写事件
+            // 捕获 Conn 指针而不是下标，主线程扩展连接表时不影响工作线程
+            Conn* c = &conn;
+            thread_pool.enqueue([this, fd, c] {
+                if (!kvs_handler(c->input.get(), c->output.get(), &c->protocol)) {
+                    c->closing = true;
+                }
+                // 有响应时唤醒主线程处理写事件，只有半个请求时继续读
                 std::lock_guard<std::mutex> lock(epoll_mutex);
-                setEvent(fd, EPOLLOUT, false);
+                bool writable = hasOutput(*c) || c->closing;
+                setEvent(fd, writable ? EPOLLOUT : EPOLLIN, false);
             });
         }
         return count;
     }
 
-    // 发送数据回调
+    static bool hasOutput(const Conn& conn) {
+        return conn.output->readableBytes() > 0 || !conn.zerocopy.empty();
+    }
+
+    // 发送输出链的下一部分：缓冲区片段和值一次聚集发送（sendmsg），超过零拷贝阈值的值
+    // 单独用 MSG_ZEROCOPY 直接从存储发送。每次成功的 MSG_ZEROCOPY 发送占用一个序号，
+    // 值一直持有到该序号的完成通知
+    ssize_t sendSegment(Conn& conn) {
+        size_t zc_threshold = conn.zc_enabled ? zerocopy_threshold : 0;
+        if (zc_threshold > 0 && conn.zerocopy.atValue() && conn.zerocopy.frontOwner()->size() >= zc_threshold) {
+            std::string_view value = conn.zerocopy.frontValue();
+            ssize_t count = send(conn.fd, value.data(), value.size(), MSG_ZEROCOPY);
+            if (count < 0 && errno == ENOBUFS) {
+                count = send(conn.fd, value.data(), value.size(), 0);  // optmem 不足，本次退回拷贝
+            } else if (count >= 0) {
+                conn.zc_inflight.emplace_back(conn.zc_next++, conn.zerocopy.frontOwner());
+            }
+            if (count > 0) {
+                conn.zerocopy.consumeValue(count);
+            }
+            return count;
+        }
+        iovec iov[MAX_IOV];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = conn.zerocopy.gather(*conn.output, iov, MAX_IOV, zc_threshold);
+        ssize_t count = sendmsg(conn.fd, &msg, 0);
+        if (count > 0) {
+            conn.zerocopy.consume(conn.output.get(), count);
+        }
+        return count;
+    }
+
+    // 发送数据回调：没发完时只保持写事件、不再读取新请求（客户端只发不收时由 TCP 窗口反压），发完后恢复读事件
     int sendCb(int fd) {
-        int count = 0;
-        if (conn_list[fd].wlength != 0) {
-            count = send(fd, conn_list[fd].wbuffer, conn_list[fd].wlength, 0);
+        Conn& conn = conn_list[fd];
+        ssize_t count = 0;
+        while (hasOutput(conn)) {
+            ssize_t sent = sendSegment(conn);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    break;
+                }
+                closeConn(fd);
+                return -1;
+            }
+            count += sent;
+        }
+        if (!hasOutput(conn)) {
+            if (conn.closing) {
+                closeConn(fd);
+                return 0;
+            }
+            if (conn.input->readableBytes() == 0) {
+                releaseBuffers(conn);  // 没有未完成的请求，连接回到空闲状态
+            }
+            setEvent(fd, EPOLLIN, false);
         }
-        setEvent(fd, EPOLLIN, false);
         return count;
     }
 
+    // 连接数只受文件描述符上限限制，启动时把软上限提到硬上限
+    void raiseFdLimit() {
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+            std::cout << "max open files: " << limit.rlim_cur << std::endl;
+        }
+    }
+
     // 初始化服务器套接字
     int initServer(unsigned short port) {
         int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;  // 重启时端口上可能还有大量 TIME_WAIT 连接
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
         sockaddr_in servaddr;
         servaddr.sin_family = AF_INET;
         servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -210,17 +394,19 @@ private:
             printf("bind failed: %s\n", strerror(errno));
         }
 
-        listen(sockfd, 10);
+        listen(sockfd, SOMAXCONN);
         return sockfd;
     }
 
 public:
-    ReactorServer(size_t thread_num = 4) : epfd(0), conn_list(CONNECTION_SIZE), thread_pool(thread_num) {}
+    ReactorServer(size_t thread_num = 4, size_t zc_threshold = 0)
+        : epfd(0), thread_pool(thread_num), zerocopy_threshold(zc_threshold) {}
 
     // 启动反应堆
-    void start(unsigned short port, std::function<int(char*, int, char*)> handler) {
+    void start(unsigned short port, std::function<bool(muduo::net::Buffer*, muduo::net::Buffer*, ProtocolState*)> handler) {
         kvs_handler = handler;
         epfd = epoll_create(1);
+        raiseFdLimit();
 
         for (int i = 0; i < MAX_PORTS; ++i) {
             int sockfd = initServer(port + i);
@@ -231,12 +417,15 @@ public:
 
         gettimeofday(&begin, nullptr);
 
+        std::vector<epoll_event> events(MAX_EVENTS);
         while (true) {
-            std::vector<epoll_event> events(1024);
-            int nready = epoll_wait(epfd, events.data(), 1024, -1);
+            int nready = epoll_wait(epfd, events.data(), MAX_EVENTS, -1);
 
             for (int i = 0; i < nready; ++i) {
                 int connfd = events[i].data.fd;
+                if (events[i].events & EPOLLERR) {
+                    errorCb(connfd);
+                }
                 if (events[i].events & EPOLLIN) {
                     conn_list[connfd].r_action.recv_callback(connfd);
                 }
@@ -248,7 +437,7 @@ public:
     }
 };
 
-void runReactorServer() {
-    ReactorServer server;
-    server.start(2000, commandHandler);
+void runReactorServer(size_t zerocopy_threshold) {
+    ReactorServer server(4, zerocopy_threshold);
+    server.start(2000, handleInput);
 }
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "resp_protocol.h"
+#include <string.h>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <thread>
+#include "coarse_clock.h"
+#include "command_handler.h"
+#include "command_table.h"
+
+namespace {
+
+// 解析 "<整数>\r\n"，p 指向整数的第一个字符
+RespParseStatus parseLine(const char* p, const char* end, int64_t* value, const char** next) {
+    const char* cr = static_cast<const char*>(memchr(p, '\r', end - p));
+    if (cr == nullptr || cr + 1 >= end) {
+        // 长度字段最多 20 个字符，超过仍找不到换行说明不是合法的 RESP
+        return end - p > 20 ? kRespError : kRespIncomplete;
+    }
+    if (cr[1] != '\n') {
+        return kRespError;
+    }
+    auto result = std::from_chars(p, cr, *value);
+    if (result.ec != std::errc() || result.ptr != cr) {
+        return kRespError;
+    }
+    *next = cr + 2;
+    return kRespComplete;
+}
+
+bool equalsIgnoreCase(std::string_view a, const char* b) {
+    size_t len = strlen(b);
+    return a.size() == len && strncasecmp(a.data(), b, len) == 0;
+}
+
+void appendLine(muduo::net::Buffer* output, char prefix, int64_t value) {
+    char buf[24];
+    buf[0] = prefix;
+    char* end = std::to_chars(buf + 1, buf + sizeof(buf) - 2, value).ptr;
+    *end++ = '\r';
+    *end++ = '\n';
+    output->append(buf, end - buf);
+}
+
+void appendRespMapHeader(muduo::net::Buffer* output, const RespSession& session, size_t count) {
+    // RESP2 没有 map 类型，用 2n 个元素的数组代替
+    if (session.version >= 3) {
+        appendLine(output, '%', static_cast<int64_t>(count));
+    } else {
+        appendRespArrayHeader(output, count * 2);
+    }
+}
+
+// SET key value [EX seconds | PX milliseconds]
+void commandSet(const std::vector<std::string_view>& args, muduo::net::Buffer* output) {
+    if (args.size() < 3) {
+        appendRespError(output, "ERR wrong number of arguments for 'set' command");
+        return;
+    }
+    int64_t ttl_ms = 0;
+    for (size_t i = 3; i < args.size(); i += 2) {
+        int64_t value = 0;
+        if (i + 1 >= args.size()) {
+            appendRespError(output, "ERR syntax error");
+            return;
+        }
+        auto result = std::from_chars(args[i + 1].data(), args[i + 1].data() + args[i + 1].size(), value);
+        if (result.ec != std::errc() || result.ptr != args[i + 1].data() + args[i + 1].size() || value <= 0) {
+            appendRespError(output, "ERR invalid expire time in 'set' command");
+            return;
+        }
+        if (equalsIgnoreCase(args[i], "EX")) {
+            if (value > std::numeric_limits<int64_t>::max() / 1000) {
+                appendRespError(output, "ERR invalid expire time in 'set' command");
+                return;
+            }
+            ttl_ms = value * 1000;
+        } else if (equalsIgnoreCase(args[i], "PX")) {
+            ttl_ms = value;
+        } else {
+            appendRespError(output, "ERR syntax error");
+            return;
+        }
+    }
+    // 与 Redis 一致，过期时刻（墙上时间毫秒）溢出时报错
+    if (ttl_ms > std::numeric_limits<int64_t>::max() - CoarseClock::wallNowMs()) {
+        appendRespError(output, "ERR invalid expire time in 'set' command");
+        return;
+    }
+    executeSet(args[1], args[2], std::chrono::milliseconds(ttl_ms));
+    appendRespSimple(output, "OK");
+}
+
+void commandGet(const std::vector<std::string_view>& args, muduo::net::Buffer* output,
+                const RespSession& session, ZeroCopyRefs* zc) {
+    if (args.size() != 2) {
+        appendRespError(output, "ERR wrong number of arguments for 'get' command");
+        return;
+    }
+    // 命中时直接把值编码进 output，不经过临时字符串；共享存储的大值只记录引用
+    CommandStatus status = executeGetWith(args[1], [output, zc](std::string_view value, const SharedValue& owner) {
+        appendLine(output, '$', static_cast<int64_t>(value.size()));
+        appendValue(output, value, owner, zc);
+        output->append("\r\n", 2);
+    });
+    if (status != kStatusOk) {
+        appendRespNull(output, session);
+    }
+}
+
+void commandDel(const std::vector<std::string_view>& args, muduo::net::Buffer* output) {
+    if (args.size() < 2) {
+        appendRespError(output, "ERR wrong number of arguments for 'del' command");
+        return;
+    }
+    int64_t deleted = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+        deleted += executeDel(args[i]) == kStatusOk;
+    }
+    appendRespInteger(output, deleted);
+}
+
+void commandExists(const std::vector<std::string_view>& args, muduo::net::Buffer* output) {
+    if (args.size() < 2) {
+        appendRespError(output, "ERR wrong number of arguments for 'exists' command");
+        return;
+    }
+    int64_t count = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+        GetResult result = KVStore::getInstance().get(args[i]);
+        count += result.exists && !result.expired;
+    }
+    appendRespInteger(output, count);
+}
+
+// HELLO [protover]：协商协议版本，返回服务端信息
+void commandHello(const std::vector<std::string_view>& args, muduo::net::Buffer* output, RespSession* session) {
+    if (args.size() >= 2) {
+        if (args[1] == "2") {
+            session->version = 2;
+        } else if (args[1] == "3") {
+            session->version = 3;
+        } else {
+            appendRespError(output, "NOPROTO unsupported protocol version");
+            return;
+        }
+    }
+    appendRespMapHeader(output, *session, 3);
+    appendRespBulk(output, "server");
+    appendRespBulk(output, "kvstore");
+    appendRespBulk(output, "proto");
+    appendRespInteger(output, session->version);
+    appendRespBulk(output, "mode");
+    appendRespBulk(output, "standalone");
+}
+
+// INFO [section]：目前只有 persistence 一节，按 Redis 的 "key:value" 行格式返回快照和变更日志的统计
+void commandInfo(const std::vector<std::string_view>& args, muduo::net::Buffer* output) {
+    SnapshotStats stats = KVStore::getInstance().snapshotStats();
+    std::string info = "# Persistence\r\n";
+    info += "snapshot_in_progress:" + std::to_string(stats.in_progress ? 1 : 0) + "\r\n";
+    info += "snapshot_count:" + std::to_string(stats.snapshots) + "\r\n";
+    info += "snapshot_failures:" + std::to_string(stats.failures) + "\r\n";
+    info += std::string("snapshot_last_status:") + (stats.last_ok ? "ok" : "err") + "\r\n";
+    info += "snapshot_last_time:" + std::to_string(stats.last_time) + "\r\n";
+    info += "snapshot_last_duration_ms:" + std::to_string(stats.last_duration_ms) + "\r\n";
+    info += "snapshot_last_bytes:" + std::to_string(stats.last_bytes) + "\r\n";
+    info += "snapshot_last_keys:" + std::to_string(stats.last_keys) + "\r\n";
+    info += "snapshot_last_cow_entries:" + std::to_string(stats.last_cow_entries) + "\r\n";
+    WalStats wal = KVStore::getInstance().walStats();
+    info += "wal_enabled:" + std::to_string(KVStore::getInstance().walEnabled() ? 1 : 0) + "\r\n";
+    info += std::string("wal_status:") + (wal.failed ? "err" : "ok") + "\r\n";
+    info += "wal_records:" + std::to_string(wal.records) + "\r\n";
+    info += "wal_bytes:" + std::to_string(wal.bytes) + "\r\n";
+    info += "wal_writes:" + std::to_string(wal.writes) + "\r\n";
+    info += "wal_syncs:" + std::to_string(wal.syncs) + "\r\n";
+    info += "wal_rewrite_in_progress:" + std::to_string(wal.rewrite_in_progress ? 1 : 0) + "\r\n";
+    info += "wal_rewrites:" + std::to_string(wal.rewrites) + "\r\n";
+    info += "wal_rewrite_failures:" + std::to_string(wal.rewrite_failures) + "\r\n";
+    info += "wal_last_rewrite_ms:" + std::to_string(wal.last_rewrite_ms) + "\r\n";
+    appendRespBulk(output, info);
+}
+
+// BGREWRITEAOF：在后台线程中重写变更日志
+void commandBgRewriteAof(muduo::net::Buffer* output) {
+    KVStore& store = KVStore::getInstance();
+    if (!store.walEnabled()) {
+        appendRespError(output, "ERR write-ahead log is disabled");
+        return;
+    }
+    if (store.walStats().rewrite_in_progress) {
+        appendRespError(output, "ERR Background append only file rewriting already in progress");
+        return;
+    }
+    std::thread([]() { KVStore::getInstance().rewriteLog(); }).detach();
+    appendRespSimple(output, "Background append only file rewriting started");
+}
+
+// 执行一条命令，返回 false 表示需要关闭连接
+bool executeRespCommand(const std::vector<std::string_view>& args, muduo::net::Buffer* output,
+                        RespSession* session, ZeroCopyRefs* zc) {
+    std::string_view name = args[0];
+    switch (lookupCommand(name)) {
+        case kCmdGet:
+            commandGet(args, output, *session, zc);
+            break;
+        case kCmdSet:
+            commandSet(args, output);
+            break;
+        case kCmdDel:
+            commandDel(args, output);
+            break;
+        case kCmdExists:
+            commandExists(args, output);
+            break;
+        case kCmdPing:
+            if (args.size() >= 2) {
+                appendRespBulk(output, args[1]);
+            } else {
+                appendRespSimple(output, "PONG");
+            }
+            break;
+        case kCmdEcho:
+            if (args.size() != 2) {
+                appendRespError(output, "ERR wrong number of arguments for 'echo' command");
+            } else {
+                appendRespBulk(output, args[1]);
+            }
+            break;
+        case kCmdHello:
+            commandHello(args, output, session);
+            break;
+        case kCmdQuit:
+            appendRespSimple(output, "OK");
+            return false;
+        case kCmdInfo:
+            commandInfo(args, output);
+            break;
+        case kCmdBgRewriteAof:
+            commandBgRewriteAof(output);
+            break;
+        case kCmdConfig:
+        case kCmdCommand:
+            // redis-benchmark / redis-cli 启动时会查询，返回空数组即可
+            appendRespArrayHeader(output, 0);
+            break;
+        default: {
+            std::string message = "ERR unknown command '";
+            message.append(name.data(), name.size() > 64 ? 64 : name.size());
+            message += "'";
+            appendRespError(output, message);
+            break;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+RespParseStatus parseRespCommand(const char* data, size_t len, std::vector<std::string_view>* args,
+                                 size_t* consumed) {
+    const char* end = data + len;
+    if (len == 0) {
+        return kRespIncomplete;
+    }
+    if (data[0] != kRespArrayPrefix) {
+        return kRespError;
+    }
+    int64_t count = 0;
+    const char* p = nullptr;
+    RespParseStatus status = parseLine(data + 1, end, &count, &p);
+    if (status != kRespComplete) {
+        return status;
+    }
+    if (count <= 0 || static_cast<size_t>(count) > kRespMaxArgs) {
+        return kRespError;
+    }
+    args->clear();
+    for (int64_t i = 0; i < count; ++i) {
+        if (p >= end) {
+            return kRespIncomplete;
+        }
+        if (*p != '$') {
+            return kRespError;
+        }
+        int64_t bulk_len = 0;
+        status = parseLine(p + 1, end, &bulk_len, &p);
+        if (status != kRespComplete) {
+            return status;
+        }
+        if (bulk_len < 0 || static_cast<size_t>(bulk_len) > kRespMaxBulkLength) {
+            return kRespError;
+        }
+        if (end - p < bulk_len + 2) {
+            return kRespIncomplete;
+        }
+        if (p[bulk_len] != '\r' || p[bulk_len + 1] != '\n') {
+            return kRespError;
+        }
+        args->emplace_back(p, static_cast<size_t>(bulk_len));
+        p += bulk_len + 2;
+    }
+    *consumed = p - data;
+    return kRespComplete;
+}
+
+bool processRespCommands(muduo::net::Buffer* input, muduo::net::Buffer* output, RespSession* session,
+                         ZeroCopyRefs* zc) {
+    std::vector<std::string_view>& args = session->args;
+    // 先解析到缓冲区中最后一条完整命令再统一丢弃，避免每条命令都移动读指针
+    const char* data = input->peek();
+    size_t len = input->readableBytes();
+    size_t offset = 0;
+    bool keep_open = true;
+    while (offset < len && data[offset] == kRespArrayPrefix && keep_open) {
+        size_t consumed = 0;
+        RespParseStatus status = parseRespCommand(data + offset, len - offset, &args, &consumed);
+        if (status == kRespIncomplete) {
+            break;
+        }
+        if (status == kRespError) {
+            appendRespError(output, "ERR Protocol error");
+            input->retrieveAll();
+            return false;
+        }
+        size_t mark = output->readableBytes();
+        keep_open = executeRespCommand(args, output, session, zc);
+        if (dbCacheDeferred()) {
+            // 需要回源数据库：撤销这条命令的响应，命令留在 input 中交给 DB 线程池执行
+            output->unwrite(output->readableBytes() - mark);
+            break;
+        }
+        offset += consumed;
+    }
+    input->retrieve(offset);
+    return keep_open;
+}
+
+void appendRespSimple(muduo::net::Buffer* output, std::string_view str) {
+    output->append("+", 1);
+    output->append(str.data(), str.size());
+    output->append("\r\n", 2);
+}
+
+void appendRespError(muduo::net::Buffer* output, std::string_view message) {
+    output->append("-", 1);
+    output->append(message.data(), message.size());
+    output->append("\r\n", 2);
+}
+
+void appendRespInteger(muduo::net::Buffer* output, int64_t value) {
+    appendLine(output, ':', value);
+}
+
+void appendRespBulk(muduo::net::Buffer* output, std::string_view str) {
+    appendLine(output, '$', static_cast<int64_t>(str.size()));
+    output->append(str.data(), str.size());
+    output->append("\r\n", 2);
+}
+
+void appendRespNull(muduo::net::Buffer* output, const RespSession& session) {
+    if (session.version >= 3) {
+        output->append("_\r\n", 3);
+    } else {
+        output->append("$-1\r\n", 5);
+    }
+}
+
+void appendRespArrayHeader(muduo::net::Buffer* output, size_t count) {
+    appendLine(output, '*', static_cast<int64_t>(count));
+}
@@ -0,0 +1,52 @@
+#ifndef RESP_PROTOCOL_H
+#define RESP_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+#include "muduo/net/Buffer.h"
+
+struct ZeroCopyRefs;
+
+// Redis 序列化协议（RESP2 / RESP3）前端，兼容 redis-cli、redis-benchmark、memtier 等工具。
+// 请求是由 bulk string 组成的数组（首字节 '*'），解析时参数以 string_view 直接指向
+// 连接的输入缓冲区，不做拷贝；一次读取中的所有完整命令依次执行，响应追加到同一个输出缓冲区。
+// 支持 PING / ECHO / GET / SET [EX|PX] / DEL / EXISTS / HELLO / QUIT / CONFIG / COMMAND。
+
+const char kRespArrayPrefix = '*';
+const size_t kRespMaxArgs = 1024 * 1024;
+const size_t kRespMaxBulkLength = 512 * 1024 * 1024;
+
+enum RespParseStatus {
+    kRespComplete,    // 解析出一条完整命令
+    kRespIncomplete,  // 数据不完整，等待更多数据
+    kRespError,       // 协议错误
+};
+
+// 连接级的 RESP 状态
+struct RespSession {
+    int version = 2;  // HELLO 协商的协议版本
+    std::vector<std::string_view> args;  // 解析用的参数数组，跨请求复用以免每条命令分配内存
+};
+
+// 从 data 解析一条命令，成功时 args 指向 data 内部，consumed 为命令占用的字节数
+RespParseStatus parseRespCommand(const char* data, size_t len, std::vector<std::string_view>* args,
+                                 size_t* consumed);
+
+// 从 input 中取出并执行所有完整的 RESP 命令，响应依次追加到 output；
+// 不完整的命令留在 input 中，遇到非 RESP 数据时停止。
+// 协议错误或 QUIT 时返回 false，调用方发送完 output 后关闭连接。
+// zc 非空时 GET 命中的大值只在 zc 中记录引用（见 zero_copy.h）。
+bool processRespCommands(muduo::net::Buffer* input, muduo::net::Buffer* output, RespSession* session,
+                         ZeroCopyRefs* zc = nullptr);
+
+// 响应编码
+void appendRespSimple(muduo::net::Buffer* output, std::string_view str);
+void appendRespError(muduo::net::Buffer* output, std::string_view message);
+void appendRespInteger(muduo::net::Buffer* output, int64_t value);
+void appendRespBulk(muduo::net::Buffer* output, std::string_view str);
+void appendRespNull(muduo::net::Buffer* output, const RespSession& session);
+void appendRespArrayHeader(muduo::net::Buffer* output, size_t count);
+
+#endif
@@ -1,7 +1,38 @@
 #ifndef __SERVER_H__
 #define __SERVER_H__
 
-void runReactorServer();
-void runProactorServer();
+#include <stddef.h>
 
-#endif
\ No newline at end of file
+// proactor（io_uring）服务器的可调参数，由 main.cc 从配置文件读取
+struct ProactorOptions {
+    // multishot accept + multishot recv + 共享的 provided buffer ring；
+    // 关闭或内核不支持时退回单次 accept / recv 到连接自己的缓冲区
+    bool multishot = true;
+    unsigned buf_ring_entries = 4096;  // buffer ring 中的缓冲区个数，2 的幂
+    unsigned buf_size = 4096;          // 每个缓冲区的字节数
+    // ring 数，每个 ring 一个线程，0 表示按可用 CPU 数；多个 ring 时 KVStore 的分片
+    // 按下标对 ring 数取模归属到各个 ring，请求转发给拥有键所在分片的 ring 执行
+    int rings = 1;
+    bool pin_cpu = true;               // 把每个 ring 的线程绑定到一个 CPU
+    // 注册文件表的大小：新连接由 direct accept 放进 ring 的文件表，recv / send 不再查进程 fd 表；
+    // 受 RLIMIT_NOFILE 限制，0 表示使用普通 fd
+    unsigned fixed_files = 65536;
+    // 注册到内核的响应缓冲区（fixed buffer）个数和大小，不超过 fixed_buf_size 的响应
+    // 拷进其中用 WRITE_FIXED 发送；注册的内存计入 RLIMIT_MEMLOCK，个数为 0 表示关闭
+    unsigned fixed_buf_count = 256;
+    unsigned fixed_buf_size = 16384;
+    // SQPOLL：每个 ring 一个内核线程轮询 SQ，提交不需要系统调用，空闲 sqpoll_idle_ms 后休眠；
+    // 降低延迟，但每个 ring 额外占用一个 CPU
+    bool sqpoll = false;
+    unsigned sqpoll_idle_ms = 1000;
+    // 不小于该字节数的值（KVStore 中按共享存储保存的值）用 SEND_ZC 直接从存储发送，0 表示关闭
+    size_t zerocopy_threshold = 0;
+};
+
+// zerocopy_threshold 非 0 时，共享存储中的大值用 MSG_ZEROCOPY 直接从存储发送
+void runReactorServer(size_t zerocopy_threshold = 0);
+void runProactorServer(const ProactorOptions& options);
+// loops 为事件循环（线程）数，0 表示按 CPU 核数
+void runMultiReactorServer(int loops);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SLOT_ARRAY_H
+#define SLOT_ARRAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 分块的稠密数组：按槽位下标 O(1) 访问，扩容时只追加新块，已有元素从不搬动，
+// 因此不会像 std::vector 那样在扩容时整体拷贝，也不会让正在使用的引用失效。
+template <typename T, size_t kChunkShift = 10>
+class SlotArray {
+public:
+    static constexpr size_t kChunkSize = size_t(1) << kChunkShift;
+    static constexpr size_t kChunkMask = kChunkSize - 1;
+
+    SlotArray() = default;
+    SlotArray(const SlotArray&) = delete;
+    SlotArray& operator=(const SlotArray&) = delete;
+
+    T& operator[](size_t slot) { return chunks_[slot >> kChunkShift][slot & kChunkMask]; }
+    const T& operator[](size_t slot) const { return chunks_[slot >> kChunkShift][slot & kChunkMask]; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 追加一个槽位并返回其引用（元素为默认构造状态）
+    T& push_back() {
+        if (size_ == chunks_.size() * kChunkSize) {
+            chunks_.emplace_back(new T[kChunkSize]);
+        }
+        return (*this)[size_++];
+    }
+
+    // 删除最后一个槽位，重置为默认状态以释放其持有的资源
+    void pop_back() {
+        --size_;
+        (*this)[size_] = T();
+        // 保留一个空闲块，避免在块边界反复分配释放
+        if (chunks_.size() > 1 && size_ + 2 * kChunkSize <= chunks_.size() * kChunkSize) {
+            chunks_.pop_back();
+        }
+    }
+
+    // 已分配的字节数
+    size_t bytes() const { return chunks_.size() * kChunkSize * sizeof(T); }
+
+private:
+    std::vector<std::unique_ptr<T[]>> chunks_;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,414 @@
+#include "snapshot.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "crc32c.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "snapshot format is little-endian");
+
+namespace {
+
+const char kFileMagic[8] = {'K', 'V', 'S', 'S', 'N', 'A', 'P', '\0'};
+const char kTrailerMagic[8] = {'K', 'V', 'S', 'S', 'E', 'N', 'D', '\0'};
+
+template <typename T>
+void store(char* p, T v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+template <typename T>
+T load(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void appendVarint(std::string* out, uint64_t v) {
+    char buf[10];
+    size_t len = 0;
+    while (v >= 0x80) {
+        buf[len++] = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    buf[len++] = static_cast<char>(v);
+    out->append(buf, len);
+}
+
+void encodeBlockHeader(const SnapshotBlockInfo& info, uint32_t codec, char* p) {
+    store<uint32_t>(p, info.stored_len);
+    store<uint32_t>(p + 4, info.raw_len);
+    store<uint32_t>(p + 8, info.records);
+    store<uint32_t>(p + 12, codec);
+    store<uint32_t>(p + 16, info.crc);
+}
+
+bool preadAll(int fd, char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = ::pread(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const SnapshotOptions& options) : options_(options) {
+    if (options_.block_size == 0) {
+        options_.block_size = SnapshotOptions().block_size;
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    abort();
+}
+
+bool SnapshotWriter::open(const std::string& filename) {
+    abort();
+    filename_ = filename;
+    tmp_filename_ = filename + ".tmp";
+    failed_ = false;
+    error_.clear();
+    index_.clear();
+    block_.clear();
+    block_records_ = 0;
+    offset_ = 0;
+    records_ = 0;
+    fd_ = ::open(tmp_filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return fail("open " + tmp_filename_);
+    }
+    block_.reserve(options_.block_size + options_.block_size / 8);
+    char header[kSnapshotHeaderSize];
+    memcpy(header, kFileMagic, sizeof(kFileMagic));
+    store<uint32_t>(header + 8, kSnapshotVersion);
+    store<uint32_t>(header + 12, 0);
+    return writeAll(header, sizeof(header));
+}
+
+bool SnapshotWriter::add(std::string_view key, std::string_view value, uint64_t expire_ms) {
+    if (failed_ || fd_ < 0) {
+        return false;
+    }
+    size_t record_len = 20 + sizeof(uint64_t) + key.size() + value.size();
+    if (!block_.empty() && block_.size() + record_len > options_.block_size && !flushBlock()) {
+        return false;
+    }
+    appendVarint(&block_, key.size());
+    appendVarint(&block_, value.size());
+    char expire[sizeof(uint64_t)];
+    store<uint64_t>(expire, expire_ms);
+    block_.append(expire, sizeof(expire));
+    block_.append(key.data(), key.size());
+    block_.append(value.data(), value.size());
+    ++block_records_;
+    ++records_;
+    if (block_.size() >= options_.block_size) {
+        return flushBlock();
+    }
+    return true;
+}
+
+bool SnapshotWriter::finish() {
+    if (failed_ || fd_ < 0) {
+        abort();
+        return false;
+    }
+    if (!block_.empty() && !flushBlock()) {
+        abort();
+        return false;
+    }
+    uint64_t index_offset = offset_;
+    std::string index(index_.size() * kSnapshotIndexEntrySize, '\0');
+    char* p = &index[0];
+    for (const SnapshotBlockInfo& info : index_) {
+        store<uint64_t>(p, info.offset);
+        store<uint32_t>(p + 8, info.stored_len);
+        store<uint32_t>(p + 12, info.raw_len);
+        store<uint32_t>(p + 16, info.records);
+        store<uint32_t>(p + 20, info.crc);
+        p += kSnapshotIndexEntrySize;
+    }
+    char trailer[kSnapshotTrailerSize];
+    store<uint64_t>(trailer, index_offset);
+    store<uint64_t>(trailer + 8, records_);
+    store<uint32_t>(trailer + 16, static_cast<uint32_t>(index_.size()));
+    store<uint32_t>(trailer + 20, crc32c::value(index.data(), index.size()));
+    memcpy(trailer + 24, kTrailerMagic, sizeof(kTrailerMagic));
+    if (!writeAll(index.data(), index.size()) || !writeAll(trailer, sizeof(trailer))) {
+        abort();
+        return false;
+    }
+    if (::fdatasync(fd_) != 0) {
+        fail("fdatasync " + tmp_filename_);
+        abort();
+        return false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+    if (::rename(tmp_filename_.c_str(), filename_.c_str()) != 0) {
+        fail("rename " + tmp_filename_);
+        ::unlink(tmp_filename_.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotWriter::flushBlock() {
+    SnapshotBlockInfo info;
+    info.offset = offset_;
+    info.raw_len = static_cast<uint32_t>(block_.size());
+    info.records = block_records_;
+    uint32_t codec = kSnapshotCodecNone;
+    const std::string* payload = &block_;
+    if (options_.codec == kSnapshotCodecZlib) {
+        uLongf len = compressBound(static_cast<uLong>(block_.size()));
+        compressed_.resize(len);
+        int ret = compress2(reinterpret_cast<Bytef*>(&compressed_[0]), &len,
+                            reinterpret_cast<const Bytef*>(block_.data()), static_cast<uLong>(block_.size()),
+                            options_.level);
+        // 压缩失败或没有变小时按原样保存
+        if (ret == Z_OK && len < block_.size()) {
+            compressed_.resize(len);
+            payload = &compressed_;
+            codec = kSnapshotCodecZlib;
+        }
+    }
+    info.stored_len = static_cast<uint32_t>(payload->size());
+
+    char header[kSnapshotBlockHeaderSize];
+    encodeBlockHeader(info, codec, header);
+    info.crc = crc32c::extend(crc32c::value(header, 16), payload->data(), payload->size());
+    store<uint32_t>(header + 16, info.crc);
+
+    iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(payload->data());
+    iov[1].iov_len = payload->size();
+    size_t total = iov[0].iov_len + iov[1].iov_len;
+    ssize_t n;
+    do {
+        n = ::writev(fd_, iov, 2);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return fail("write " + tmp_filename_);
+    }
+    size_t written = static_cast<size_t>(n);
+    offset_ += written;
+    // 短写时把剩下的部分补写完
+    if (written < sizeof(header)) {
+        if (!writeAll(header + written, sizeof(header) - written) ||
+            !writeAll(payload->data(), payload->size())) {
+            return false;
+        }
+    } else if (written < total) {
+        size_t done = written - sizeof(header);
+        if (!writeAll(payload->data() + done, payload->size() - done)) {
+            return false;
+        }
+    }
+    index_.push_back(info);
+    block_.clear();
+    block_records_ = 0;
+    return true;
+}
+
+bool SnapshotWriter::writeAll(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return fail("write " + tmp_filename_);
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset_ += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool SnapshotWriter::fail(const std::string& what) {
+    if (!failed_) {
+        error_ = what + ": " + strerror(errno);
+    }
+    failed_ = true;
+    return false;
+}
+
+void SnapshotWriter::abort() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(tmp_filename_.c_str());
+    }
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool SnapshotReader::isSnapshotFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(kFileMagic)];
+    bool ok = preadAll(fd, magic, sizeof(magic), 0) && memcmp(magic, kFileMagic, sizeof(magic)) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool SnapshotReader::open(const std::string& filename) {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    index_.clear();
+    records_ = 0;
+    error_.clear();
+    fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        return fail("open " + filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        return fail("stat " + filename + ": " + strerror(errno));
+    }
+    file_size_ = static_cast<uint64_t>(st.st_size);
+    if (file_size_ < kSnapshotHeaderSize + kSnapshotTrailerSize) {
+        return fail("file too small");
+    }
+
+    char header[kSnapshotHeaderSize];
+    if (!preadAll(fd_, header, sizeof(header), 0) || memcmp(header, kFileMagic, sizeof(kFileMagic)) != 0) {
+        return fail("bad file magic");
+    }
+    uint32_t version = load<uint32_t>(header + 8);
+    if (version == 0 || version > kSnapshotVersion) {
+        return fail("unsupported version " + std::to_string(version));
+    }
+
+    char trailer[kSnapshotTrailerSize];
+    if (!preadAll(fd_, trailer, sizeof(trailer), file_size_ - kSnapshotTrailerSize) ||
+        memcmp(trailer + 24, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+        return fail("bad trailer (truncated file?)");
+    }
+    uint64_t index_offset = load<uint64_t>(trailer);
+    uint64_t records = load<uint64_t>(trailer + 8);
+    uint32_t block_count = load<uint32_t>(trailer + 16);
+    uint32_t index_crc = load<uint32_t>(trailer + 20);
+    uint64_t index_len = static_cast<uint64_t>(block_count) * kSnapshotIndexEntrySize;
+    if (index_offset < kSnapshotHeaderSize || index_offset + index_len != file_size_ - kSnapshotTrailerSize) {
+        return fail("bad index offset");
+    }
+
+    std::string index(static_cast<size_t>(index_len), '\0');
+    if (!preadAll(fd_, &index[0], index.size(), index_offset)) {
+        return fail("read index failed");
+    }
+    if (crc32c::value(index.data(), index.size()) != index_crc) {
+        return fail("index checksum mismatch");
+    }
+    // 各块首尾相接地排在文件头和索引之间
+    index_.resize(block_count);
+    uint64_t expected = kSnapshotHeaderSize;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < block_count; ++i) {
+        const char* p = index.data() + static_cast<size_t>(i) * kSnapshotIndexEntrySize;
+        SnapshotBlockInfo& info = index_[i];
+        info.offset = load<uint64_t>(p);
+        info.stored_len = load<uint32_t>(p + 8);
+        info.raw_len = load<uint32_t>(p + 12);
+        info.records = load<uint32_t>(p + 16);
+        info.crc = load<uint32_t>(p + 20);
+        if (info.offset != expected) {
+            return fail("block " + std::to_string(i) + " misplaced");
+        }
+        expected += kSnapshotBlockHeaderSize + info.stored_len;
+        total += info.records;
+    }
+    if (expected != index_offset || total != records) {
+        return fail("index does not match trailer");
+    }
+    records_ = records;
+    return true;
+}
+
+bool SnapshotReader::readBlock(size_t i, std::string* raw) const {
+    const SnapshotBlockInfo& info = index_[i];
+    char header[kSnapshotBlockHeaderSize];
+    // 没有压缩的块直接读进 raw，压缩的块先读进线程私有的缓冲区
+    static thread_local std::string stored;
+    std::string* payload = raw;
+    payload->resize(info.stored_len);
+    iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = &(*payload)[0];
+    iov[1].iov_len = payload->size();
+    size_t total = sizeof(header) + info.stored_len;
+    ssize_t n;
+    do {
+        n = ::preadv(fd_, iov, 2, static_cast<off_t>(info.offset));
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return false;
+    }
+    if (static_cast<size_t>(n) < total) {
+        size_t done = static_cast<size_t>(n);
+        if (done < sizeof(header) &&
+            !preadAll(fd_, header + done, sizeof(header) - done, info.offset + done)) {
+            return false;
+        }
+        size_t payload_done = done > sizeof(header) ? done - sizeof(header) : 0;
+        if (!preadAll(fd_, &(*payload)[payload_done], payload->size() - payload_done,
+                      info.offset + sizeof(header) + payload_done)) {
+            return false;
+        }
+    }
+
+    uint32_t codec = load<uint32_t>(header + 12);
+    if (load<uint32_t>(header) != info.stored_len || load<uint32_t>(header + 4) != info.raw_len ||
+        load<uint32_t>(header + 8) != info.records || load<uint32_t>(header + 16) != info.crc) {
+        return false;
+    }
+    if (crc32c::extend(crc32c::value(header, 16), payload->data(), payload->size()) != info.crc) {
+        return false;
+    }
+    if (codec == kSnapshotCodecNone) {
+        return info.stored_len == info.raw_len;
+    }
+    if (codec != kSnapshotCodecZlib) {
+        return false;
+    }
+    stored.swap(*raw);
+    raw->resize(info.raw_len);
+    uLongf len = info.raw_len;
+    int ret = uncompress(reinterpret_cast<Bytef*>(&(*raw)[0]), &len,
+                         reinterpret_cast<const Bytef*>(stored.data()), static_cast<uLong>(stored.size()));
+    return ret == Z_OK && len == info.raw_len;
+}
+
+bool SnapshotReader::fail(const std::string& what) {
+    error_ = what;
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    return false;
+}
@@ -0,0 +1,180 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 二进制快照文件格式，整数均为小端：
+//
+//   文件头 | magic "KVSSNAP\0" (8) | version (4) | flags (4) |
+//   数据块 | 块头 (20) | 块数据 (stored_len 字节) |              × block_count
+//   索引   | offset (8) | stored_len (4) | raw_len (4) | records (4) | crc (4) |  × block_count
+//   文件尾 | index_offset (8) | records (8) | block_count (4) | index_crc (4) | magic "KVSSEND\0" (8) |
+//
+//   块头：stored_len (4) | raw_len (4) | records (4) | codec (4) | crc (4)
+//   crc 为块头前 16 字节加块数据的 CRC32C；codec 为 0 时块数据就是原始记录，为 1 时是 zlib 压缩后的记录，
+//   压缩后不变小的块按原样保存。
+//   记录：key_len (varint) | value_len (varint) | expire_ms (8) | key | value
+//   expire_ms 是墙上时间的毫秒数，kSnapshotNoExpire 表示不过期。
+//
+// 写入方按块流式写出，不需要把整个数据集放在内存中；文件先写到 <filename>.tmp，
+// 完整写完并 fdatasync 后再 rename，中途崩溃不会破坏上一份快照。
+// 读取方先校验文件头、文件尾和索引，再按索引逐块读取、校验 CRC、解压，各块互不依赖。
+
+const uint32_t kSnapshotVersion = 1;
+const uint64_t kSnapshotNoExpire = UINT64_MAX;
+const size_t kSnapshotHeaderSize = 16;
+const size_t kSnapshotBlockHeaderSize = 20;
+const size_t kSnapshotIndexEntrySize = 24;
+const size_t kSnapshotTrailerSize = 32;
+
+enum SnapshotCodec : uint32_t {
+    kSnapshotCodecNone = 0,
+    kSnapshotCodecZlib = 1,
+};
+
+struct SnapshotOptions {
+    size_t block_size = 1 << 20;               // 每块原始记录的目标字节数，超过该大小的单条记录独占一块
+    SnapshotCodec codec = kSnapshotCodecNone;  // 块压缩算法
+    int level = 1;                             // zlib 压缩级别（1-9）
+};
+
+// 一条解析出的记录，key / value 指向块数据
+struct SnapshotRecord {
+    std::string_view key;
+    std::string_view value;
+    uint64_t expire_ms = kSnapshotNoExpire;
+};
+
+// 索引中的一项
+struct SnapshotBlockInfo {
+    uint64_t offset = 0;  // 块头在文件中的偏移
+    uint32_t stored_len = 0;
+    uint32_t raw_len = 0;
+    uint32_t records = 0;
+    uint32_t crc = 0;
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const SnapshotOptions& options = SnapshotOptions());
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // 创建 <filename>.tmp 并写入文件头
+    bool open(const std::string& filename);
+    // 追加一条记录，攒满一块后写出；写盘失败后返回 false，之后的调用直接失败
+    bool add(std::string_view key, std::string_view value, uint64_t expire_ms);
+    // 写出最后一块、索引和文件尾，fdatasync 后替换 filename；失败时删除临时文件
+    bool finish();
+
+    uint64_t records() const { return records_; }
+    uint64_t bytesWritten() const { return offset_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool flushBlock();
+    bool writeAll(const char* data, size_t len);
+    bool fail(const std::string& what);
+    void abort();
+
+    SnapshotOptions options_;
+    std::string filename_;
+    std::string tmp_filename_;
+    int fd_ = -1;
+    bool failed_ = false;
+    std::string block_;       // 当前块的原始记录
+    uint32_t block_records_ = 0;
+    std::string compressed_;  // 压缩缓冲区，各块复用
+    std::vector<SnapshotBlockInfo> index_;
+    uint64_t offset_ = 0;
+    uint64_t records_ = 0;
+    std::string error_;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader() = default;
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    // 文件以快照 magic 开头（否则是旧的文本格式）
+    static bool isSnapshotFile(const std::string& filename);
+
+    // 打开文件并校验文件头、文件尾和索引
+    bool open(const std::string& filename);
+
+    size_t blockCount() const { return index_.size(); }
+    uint64_t records() const { return records_; }
+    uint64_t fileSize() const { return file_size_; }
+    const SnapshotBlockInfo& block(size_t i) const { return index_[i]; }
+    const std::string& error() const { return error_; }
+
+    // 读取第 i 块，校验块头与索引一致、CRC 正确，解压后的原始记录写入 raw；
+    // 只用 pread，多个线程可以并发读取不同的块
+    bool readBlock(size_t i, std::string* raw) const;
+
+    // 逐条解析一块原始记录并调用 fn(const SnapshotRecord&)，记录数或长度不符时返回 false
+    template <typename Fn>
+    static bool parseBlock(std::string_view raw, uint32_t records, Fn&& fn);
+
+private:
+    static bool readVarint(const char*& p, const char* end, uint64_t* value);
+    bool fail(const std::string& what);
+
+    int fd_ = -1;
+    uint64_t file_size_ = 0;
+    uint64_t records_ = 0;
+    std::vector<SnapshotBlockInfo> index_;
+    std::string error_;
+};
+
+inline bool SnapshotReader::readVarint(const char*& p, const char* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Fn>
+bool SnapshotReader::parseBlock(std::string_view raw, uint32_t records, Fn&& fn) {
+    const char* p = raw.data();
+    const char* end = p + raw.size();
+    for (uint32_t i = 0; i < records; ++i) {
+        uint64_t key_len = 0;
+        uint64_t value_len = 0;
+        if (!readVarint(p, end, &key_len) || !readVarint(p, end, &value_len)) {
+            return false;
+        }
+        size_t left = static_cast<size_t>(end - p);
+        if (left < sizeof(uint64_t) || key_len > left - sizeof(uint64_t) ||
+            value_len > left - sizeof(uint64_t) - key_len) {
+            return false;
+        }
+        SnapshotRecord record;
+        memcpy(&record.expire_ms, p, sizeof(uint64_t));  // 只支持小端机器
+        p += sizeof(uint64_t);
+        record.key = std::string_view(p, static_cast<size_t>(key_len));
+        p += key_len;
+        record.value = std::string_view(p, static_cast<size_t>(value_len));
+        p += value_len;
+        fn(record);
+    }
+    return p == end;
+}
+
+#endif
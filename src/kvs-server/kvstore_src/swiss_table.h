@@ -0,0 +1,301 @@
+#ifndef SWISS_TABLE_H
+#define SWISS_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Swiss table 风格的开放寻址索引：hash -> 槽位下标
+// 每个位置一个控制字节（空 / 已删除 / 7 位哈希指纹），16 个一组用 SSE2 一次比较；
+// 键值本身存放在分片的稠密槽位数组中，这里只保存 4 字节槽位下标，比较键时回调调用方。
+//
+// 扩容是渐进式的：超过负载因子时只分配新表，旧表保留；之后每次插入 / 删除迁移
+// kMigrateGroupsPerOp 个组，后台线程也可以调用 migrate() 推进，迁移期间查找两张表都查。
+class SwissIndex {
+public:
+    using HashOf = std::function<uint64_t(uint32_t)>;
+
+    static constexpr uint32_t kNotFound = UINT32_MAX;
+    static constexpr size_t kGroupWidth = 16;
+    static constexpr size_t kMigrateGroupsPerOp = 2;
+
+    // hash_of(slot) 返回槽位中键的完整哈希，迁移时用于重新计算位置
+    explicit SwissIndex(HashOf hash_of) : hash_of_(std::move(hash_of)) {}
+    SwissIndex(const SwissIndex&) = delete;
+    SwissIndex& operator=(const SwissIndex&) = delete;
+
+    size_t size() const { return table_.size + old_.size; }
+    size_t capacity() const { return table_.capacity; }
+    bool rehashing() const { return old_.capacity != 0; }
+    // 控制字节和槽位下标占用的字节数（迁移期间包含旧表）
+    size_t bytes() const {
+        return (table_.capacity + old_.capacity) * (sizeof(int8_t) + sizeof(uint32_t));
+    }
+
+    // 查找满足 eq(slot) 的槽位，找不到返回 kNotFound；只读，可在共享锁内并发调用
+    template <typename Eq>
+    uint32_t find(uint64_t hash, Eq&& eq) const {
+        uint32_t slot = table_.find(hash, eq);
+        if (slot == kNotFound && rehashing()) {
+            slot = old_.find(hash, eq);
+        }
+        return slot;
+    }
+
+    // 插入一个新映射（调用方保证键不存在）
+    void insert(uint64_t hash, uint32_t slot) {
+        migrate(kMigrateGroupsPerOp);
+        if ((table_.size + table_.deleted + 1) * 8 > table_.capacity * 7) {
+            // 上一轮迁移还没完成时先同步做完，保证同一时刻最多两张表
+            migrate(SIZE_MAX);
+            size_t live = table_.size + 1;
+            startRehash(live * 8 > table_.capacity * 7 / 2 ? table_.capacity * 2 : table_.capacity);
+            migrate(kMigrateGroupsPerOp);
+        }
+        table_.insertNoGrow(hash, slot);
+    }
+
+    // 删除映射 hash -> slot
+    bool erase(uint64_t hash, uint32_t slot) {
+        migrate(kMigrateGroupsPerOp);
+        return table_.erase(hash, slot) || (rehashing() && old_.erase(hash, slot));
+    }
+
+    // 槽位被搬动后更新映射 hash -> old_slot 为 hash -> new_slot
+    bool replace(uint64_t hash, uint32_t old_slot, uint32_t new_slot) {
+        return table_.replace(hash, old_slot, new_slot) ||
+               (rehashing() && old_.replace(hash, old_slot, new_slot));
+    }
+
+    // 把旧表中最多 groups 个组迁移到新表，返回迁移后是否仍在迁移中
+    bool migrate(size_t groups) {
+        if (!rehashing()) {
+            return false;
+        }
+        size_t total = old_.capacity / kGroupWidth;
+        for (; groups > 0 && migrate_group_ < total; --groups, ++migrate_group_) {
+            size_t start = migrate_group_ * kGroupWidth;
+            for (size_t pos = start; pos < start + kGroupWidth; ++pos) {
+                if (old_.ctrl[pos] >= 0) {
+                    uint32_t slot = old_.slots[pos];
+                    // 留墓碑而不是置空：旧表中尚未迁移的键的探测序列可能经过这个组
+                    old_.ctrl[pos] = kDeleted;
+                    ++old_.deleted;
+                    --old_.size;
+                    table_.insertNoGrow(hash_of_(slot), slot);
+                }
+            }
+        }
+        if (migrate_group_ >= total) {
+            old_.reset();
+            migrate_group_ = 0;
+            return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        table_.reset();
+        old_.reset();
+        migrate_group_ = 0;
+    }
+
+private:
+    static constexpr int8_t kEmpty = -128;  // 0b10000000
+    static constexpr int8_t kDeleted = -2;  // 0b11111110
+
+    static size_t h1(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+    static int8_t h2(uint64_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+    static uint32_t lowestBit(uint32_t bits) { return static_cast<uint32_t>(__builtin_ctz(bits)); }
+
+    // 16 字节控制组，返回匹配位置的位图
+    struct Group {
+#ifdef __SSE2__
+        explicit Group(const int8_t* pos)
+            : ctrl(_mm_load_si128(reinterpret_cast<const __m128i*>(pos))) {}
+        uint32_t match(int8_t h) const {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), ctrl)));
+        }
+        uint32_t matchEmpty() const { return match(kEmpty); }
+        // 空位和墓碑的最高位都是 1
+        uint32_t matchEmptyOrDeleted() const { return static_cast<uint32_t>(_mm_movemask_epi8(ctrl)); }
+        __m128i ctrl;
+#else
+        explicit Group(const int8_t* pos) : ctrl(pos) {}
+        uint32_t match(int8_t h) const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < kGroupWidth; ++i) {
+                bits |= static_cast<uint32_t>(ctrl[i] == h) << i;
+            }
+            return bits;
+        }
+        uint32_t matchEmpty() const { return match(kEmpty); }
+        uint32_t matchEmptyOrDeleted() const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < kGroupWidth; ++i) {
+                bits |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+            }
+            return bits;
+        }
+        const int8_t* ctrl;
+#endif
+    };
+
+    // 按组做三角数探测，组数为 2 的幂时保证遍历所有组
+    class ProbeSeq {
+    public:
+        ProbeSeq(size_t hash, size_t mask) : mask_(mask), group_(hash & mask), step_(0) {}
+        size_t offset() const { return group_ * kGroupWidth; }
+        void next() {
+            ++step_;
+            group_ = (group_ + step_) & mask_;
+        }
+
+    private:
+        size_t mask_;
+        size_t group_;
+        size_t step_;
+    };
+
+    struct AlignedDelete {
+        void operator()(int8_t* p) const { ::operator delete[](p, std::align_val_t(kGroupWidth)); }
+    };
+
+    // 一张开放寻址表
+    struct Table {
+        std::unique_ptr<int8_t[], AlignedDelete> ctrl;
+        std::unique_ptr<uint32_t[]> slots;
+        size_t capacity = 0;   // 位置总数，为 16 的 2 的幂倍
+        size_t size = 0;
+        size_t deleted = 0;    // 墓碑数量
+
+        size_t groupMask() const { return capacity / kGroupWidth - 1; }
+
+        void allocate(size_t new_capacity) {
+            // 控制字节按 16 字节对齐，满足 SSE2 对齐加载
+            ctrl.reset(static_cast<int8_t*>(::operator new[](new_capacity, std::align_val_t(kGroupWidth))));
+            std::memset(ctrl.get(), kEmpty, new_capacity);
+            slots.reset(new uint32_t[new_capacity]);
+            capacity = new_capacity;
+            size = 0;
+            deleted = 0;
+        }
+
+        void reset() {
+            ctrl.reset();
+            slots.reset();
+            capacity = size = deleted = 0;
+        }
+
+        template <typename Eq>
+        uint32_t find(uint64_t hash, Eq& eq) const {
+            if (capacity == 0) {
+                return kNotFound;
+            }
+            ProbeSeq seq(h1(hash), groupMask());
+            while (true) {
+                Group group(ctrl.get() + seq.offset());
+                for (uint32_t bits = group.match(h2(hash)); bits != 0; bits &= bits - 1) {
+                    uint32_t slot = slots[seq.offset() + lowestBit(bits)];
+                    if (eq(slot)) {
+                        return slot;
+                    }
+                }
+                if (group.matchEmpty() != 0) {
+                    return kNotFound;
+                }
+                seq.next();
+            }
+        }
+
+        size_t locate(uint64_t hash, uint32_t slot) const {
+            if (capacity == 0) {
+                return SIZE_MAX;
+            }
+            ProbeSeq seq(h1(hash), groupMask());
+            while (true) {
+                Group group(ctrl.get() + seq.offset());
+                for (uint32_t bits = group.match(h2(hash)); bits != 0; bits &= bits - 1) {
+                    size_t pos = seq.offset() + lowestBit(bits);
+                    if (slots[pos] == slot) {
+                        return pos;
+                    }
+                }
+                if (group.matchEmpty() != 0) {
+                    return SIZE_MAX;
+                }
+                seq.next();
+            }
+        }
+
+        void insertNoGrow(uint64_t hash, uint32_t slot) {
+            ProbeSeq seq(h1(hash), groupMask());
+            while (true) {
+                uint32_t bits = Group(ctrl.get() + seq.offset()).matchEmptyOrDeleted();
+                if (bits != 0) {
+                    size_t pos = seq.offset() + lowestBit(bits);
+                    if (ctrl[pos] == kDeleted) {
+                        --deleted;
+                    }
+                    ctrl[pos] = h2(hash);
+                    slots[pos] = slot;
+                    ++size;
+                    return;
+                }
+                seq.next();
+            }
+        }
+
+        bool erase(uint64_t hash, uint32_t slot) {
+            size_t pos = locate(hash, slot);
+            if (pos == SIZE_MAX) {
+                return false;
+            }
+            // 所在组还有空位说明没有探测序列越过该组，可以直接置空，否则留下墓碑
+            size_t group_start = pos & ~(kGroupWidth - 1);
+            if (Group(ctrl.get() + group_start).matchEmpty() != 0) {
+                ctrl[pos] = kEmpty;
+            } else {
+                ctrl[pos] = kDeleted;
+                ++deleted;
+            }
+            --size;
+            return true;
+        }
+
+        bool replace(uint64_t hash, uint32_t old_slot, uint32_t new_slot) {
+            size_t pos = locate(hash, old_slot);
+            if (pos == SIZE_MAX) {
+                return false;
+            }
+            slots[pos] = new_slot;
+            return true;
+        }
+    };
+
+    // 开始一轮迁移：当前表变为旧表，分配新表（容量不变时等价于清理墓碑）
+    void startRehash(size_t new_capacity) {
+        if (new_capacity < kGroupWidth) {
+            new_capacity = kGroupWidth;
+        }
+        old_ = std::move(table_);
+        table_.allocate(new_capacity);
+        migrate_group_ = 0;
+        if (old_.size == 0) {
+            old_.reset();
+        }
+    }
+
+    HashOf hash_of_;
+    Table table_;             // 新插入总是进入这张表
+    Table old_;               // 迁移中的旧表，capacity 为 0 表示没有迁移
+    size_t migrate_group_ = 0; // 旧表中下一个待迁移的组
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 分层时间轮：按槽位下标管理过期时间，时间单位是调用方定义的 tick。
+// 共 kLevels 层，每层 kBuckets 个桶，第 L 层每个桶覆盖 kBuckets^L 个 tick；
+// 到期时间超出最高层范围的槽位放在溢出链表，最高层转完一圈时重新分配。
+// 每个 tick 只处理第 0 层的一个桶，高层桶在低层转完一圈时下沉（cascade），
+// 因此推进时间的代价只与到期的键数有关，与键的总数无关。
+// 桶是以槽位下标串联的双向链表，分片删除槽位时调用 cancel / move 保持同步。
+class TimingWheel {
+public:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr int kBucketBits = 8;
+    static constexpr int kLevels = 4;
+    static constexpr uint32_t kBuckets = 1u << kBucketBits;
+    static constexpr uint32_t kBucketMask = kBuckets - 1;
+    // 每个槽位的元数据字节数（前后指针、所在桶、到期 tick）
+    static constexpr size_t kSlotBytes = 2 * sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint64_t);
+
+    explicit TimingWheel(uint64_t now_tick = 0) : current_(now_tick), lists_(kLevels * kBuckets + 2, kNil) {}
+
+    size_t size() const { return size_; }
+    uint64_t currentTick() const { return current_; }
+    bool scheduled(uint32_t slot) const { return slot < where_.size() && where_[slot] != kNone; }
+    uint64_t expireTick(uint32_t slot) const { return expire_[slot]; }
+
+    // 设置（或重新设置）槽位的到期 tick
+    void schedule(uint32_t slot, uint64_t tick) {
+        if (slot >= where_.size()) {
+            size_t size = static_cast<size_t>(slot) + 1;
+            prev_.resize(size, kNil);
+            next_.resize(size, kNil);
+            where_.resize(size, kNone);
+            expire_.resize(size, 0);
+        }
+        if (where_[slot] != kNone) {
+            unlink(slot);
+        } else {
+            ++size_;
+        }
+        expire_[slot] = tick;
+        place(slot);
+    }
+
+    // 取消槽位的过期时间（未设置时什么也不做）
+    void cancel(uint32_t slot) {
+        if (scheduled(slot)) {
+            unlink(slot);
+            where_[slot] = kNone;
+            --size_;
+        }
+    }
+
+    // 槽位 from 被搬到 to（to < from 且已经 cancel），链表中的位置原样继承
+    void move(uint32_t from, uint32_t to) {
+        if (!scheduled(from)) {
+            return;
+        }
+        uint32_t prev = prev_[from];
+        uint32_t next = next_[from];
+        uint16_t where = where_[from];
+        prev_[to] = prev;
+        next_[to] = next;
+        where_[to] = where;
+        expire_[to] = expire_[from];
+        if (prev != kNil) {
+            next_[prev] = to;
+        } else {
+            lists_[where] = to;
+        }
+        if (next != kNil) {
+            prev_[next] = to;
+        }
+        prev_[from] = next_[from] = kNil;
+        where_[from] = kNone;
+    }
+
+    // 推进到 now_tick，弹出一个已到期的槽位，没有时返回 kNil。
+    // 调用方每次弹出后可以删除槽位（会触发 cancel / move），弹出数量由调用方控制，
+    // 没处理完的到期槽位留在就绪链表中，下次继续。
+    uint32_t popExpired(uint64_t now_tick) {
+        while (lists_[kReady] == kNil) {
+            if (current_ >= now_tick) {
+                return kNil;
+            }
+            if (size_ == 0) {
+                current_ = now_tick;
+                return kNil;
+            }
+            advance();
+        }
+        uint32_t slot = lists_[kReady];
+        unlink(slot);
+        where_[slot] = kNone;
+        --size_;
+        return slot;
+    }
+
+    void clear() {
+        prev_.clear();
+        next_.clear();
+        where_.clear();
+        expire_.clear();
+        lists_.assign(lists_.size(), kNil);
+        size_ = 0;
+    }
+
+private:
+    static constexpr uint16_t kReady = kLevels * kBuckets;        // 已到期等待弹出
+    static constexpr uint16_t kOverflow = kLevels * kBuckets + 1; // 超出最高层范围
+    static constexpr uint16_t kNone = UINT16_MAX;                 // 未设置过期时间
+
+    // 按与当前 tick 的距离选择层，层内按到期 tick 的对应位选择桶
+    void place(uint32_t slot) {
+        uint64_t tick = expire_[slot];
+        uint16_t where;
+        if (tick <= current_) {
+            where = kReady;
+        } else {
+            uint64_t delta = tick - current_;
+            where = kOverflow;
+            for (int level = 0; level < kLevels; ++level) {
+                if (delta < (uint64_t(1) << (kBucketBits * (level + 1)))) {
+                    where = static_cast<uint16_t>(level * kBuckets +
+                                                  ((tick >> (kBucketBits * level)) & kBucketMask));
+                    break;
+                }
+            }
+        }
+        where_[slot] = where;
+        prev_[slot] = kNil;
+        next_[slot] = lists_[where];
+        if (lists_[where] != kNil) {
+            prev_[lists_[where]] = slot;
+        }
+        lists_[where] = slot;
+    }
+
+    void unlink(uint32_t slot) {
+        uint32_t prev = prev_[slot];
+        uint32_t next = next_[slot];
+        if (prev != kNil) {
+            next_[prev] = next;
+        } else {
+            lists_[where_[slot]] = next;
+        }
+        if (next != kNil) {
+            prev_[next] = prev;
+        }
+        prev_[slot] = next_[slot] = kNil;
+    }
+
+    // 把一个桶中的槽位按新的当前 tick 重新分配
+    void cascade(uint16_t bucket) {
+        uint32_t slot = lists_[bucket];
+        lists_[bucket] = kNil;
+        while (slot != kNil) {
+            uint32_t next = next_[slot];
+            place(slot);
+            slot = next;
+        }
+    }
+
+    // 前进一个 tick：低层转完一圈时先让高层对应的桶下沉，再把第 0 层的桶移入就绪链表
+    void advance() {
+        ++current_;
+        int level = 1;
+        while (level < kLevels && ((current_ >> (kBucketBits * level)) << (kBucketBits * level)) == current_) {
+            ++level;
+        }
+        if (level == kLevels) {
+            cascade(kOverflow);
+        }
+        for (int l = level - 1; l >= 1; --l) {
+            cascade(static_cast<uint16_t>(l * kBuckets + ((current_ >> (kBucketBits * l)) & kBucketMask)));
+        }
+        cascade(static_cast<uint16_t>(current_ & kBucketMask));
+    }
+
+    uint64_t current_;            // 已处理到的 tick
+    std::vector<uint32_t> lists_; // 每个桶的链表头，最后两个是就绪链表和溢出链表
+    std::vector<uint32_t> prev_;
+    std::vector<uint32_t> next_;
+    std::vector<uint16_t> where_; // 槽位所在的桶
+    std::vector<uint64_t> expire_;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,563 @@
+#include "wal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include "crc32c.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wal format is little-endian");
+
+namespace {
+
+const char kWalMagic[8] = {'K', 'V', 'S', 'W', 'A', 'L', '\0', '\0'};
+const uint32_t kWalMaxPayload = 1u << 30;  // 超过的长度视为损坏
+const size_t kReplayChunk = 4 << 20;
+
+template <typename T>
+void store(char* p, T v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+template <typename T>
+T load(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void appendVarint(std::string* out, uint64_t v) {
+    char buf[10];
+    size_t len = 0;
+    while (v >= 0x80) {
+        buf[len++] = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    buf[len++] = static_cast<char>(v);
+    out->append(buf, len);
+}
+
+bool readVarint(const char*& p, const char* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeHeader(int fd) {
+    char header[kWalHeaderSize];
+    memcpy(header, kWalMagic, sizeof(kWalMagic));
+    store<uint32_t>(header + 8, kWalVersion);
+    store<uint32_t>(header + 12, 0);
+    return writeAll(fd, header, sizeof(header));
+}
+
+bool decodePayload(const char* p, const char* end, WalRecord* record) {
+    if (p == end) {
+        return false;
+    }
+    uint8_t op = static_cast<uint8_t>(*p++);
+    if (op != kWalSet && op != kWalDel) {
+        return false;
+    }
+    uint64_t key_len = 0;
+    uint64_t value_len = 0;
+    if (!readVarint(p, end, &key_len) || !readVarint(p, end, &value_len)) {
+        return false;
+    }
+    size_t left = static_cast<size_t>(end - p);
+    if (left < sizeof(uint64_t) || key_len + value_len != left - sizeof(uint64_t)) {
+        return false;
+    }
+    record->op = static_cast<WalOp>(op);
+    record->expire_ms = load<uint64_t>(p);
+    p += sizeof(uint64_t);
+    record->key = std::string_view(p, static_cast<size_t>(key_len));
+    record->value = std::string_view(p + key_len, static_cast<size_t>(value_len));
+    return true;
+}
+
+// 新建文件后同步所在目录，保证目录项也已落盘
+void syncDirectory(const std::string& filename) {
+    size_t slash = filename.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : filename.substr(0, slash == 0 ? 1 : slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+}  // namespace
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+bool WriteAheadLog::replay(const std::string& filename, const std::function<void(const WalRecord&)>& fn,
+                           uint64_t* valid_bytes, uint64_t* records, std::string* error) {
+    *valid_bytes = 0;
+    *records = 0;
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        *error = "open " + filename + ": " + strerror(errno);
+        return false;
+    }
+    std::string buf;
+    size_t pos = 0;      // buf 中下一条记录的位置
+    bool eof = false;
+    // 读到至少 need 字节未处理的数据，文件结束时返回 false
+    auto fill = [&](size_t need) {
+        while (buf.size() - pos < need && !eof) {
+            if (pos > 0) {
+                buf.erase(0, pos);
+                pos = 0;
+            }
+            size_t old = buf.size();
+            buf.resize(old + std::max(kReplayChunk, need));
+            ssize_t n;
+            do {
+                n = ::read(fd, &buf[old], buf.size() - old);
+            } while (n < 0 && errno == EINTR);
+            buf.resize(old + (n > 0 ? static_cast<size_t>(n) : 0));
+            eof = n <= 0;
+        }
+        return buf.size() - pos >= need;
+    };
+
+    if (!fill(kWalHeaderSize)) {
+        ::close(fd);  // 空文件或文件头没写完，按新文件处理
+        return true;
+    }
+    if (memcmp(buf.data(), kWalMagic, sizeof(kWalMagic)) != 0 ||
+        load<uint32_t>(buf.data() + 8) == 0 || load<uint32_t>(buf.data() + 8) > kWalVersion) {
+        ::close(fd);
+        *error = filename + " is not a supported write-ahead log";
+        return false;
+    }
+    pos = kWalHeaderSize;
+    uint64_t valid = kWalHeaderSize;
+    WalRecord record;
+    while (fill(kWalRecordHeaderSize)) {
+        uint32_t len = load<uint32_t>(buf.data() + pos);
+        uint32_t crc = load<uint32_t>(buf.data() + pos + 4);
+        if (len > kWalMaxPayload || !fill(kWalRecordHeaderSize + len)) {
+            break;
+        }
+        const char* payload = buf.data() + pos + kWalRecordHeaderSize;
+        if (crc32c::value(payload, len) != crc || !decodePayload(payload, payload + len, &record)) {
+            break;
+        }
+        fn(record);
+        pos += kWalRecordHeaderSize + len;
+        valid += kWalRecordHeaderSize + len;
+        ++*records;
+    }
+    ::close(fd);
+    *valid_bytes = valid;
+    return true;
+}
+
+bool WriteAheadLog::open(const std::string& filename, uint64_t valid_bytes, const WalOptions& options,
+                         std::string* error) {
+    close();
+    filename_ = filename;
+    options_ = options;
+    if (options_.interval_ms <= 0) {
+        options_.interval_ms = 1000;
+    }
+    fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        *error = "open " + filename + ": " + strerror(errno);
+        return false;
+    }
+    // 截掉崩溃时没写完的尾部；文件头不完整时整个重写
+    if (valid_bytes < kWalHeaderSize) {
+        valid_bytes = 0;
+    }
+    if (::ftruncate(fd_, static_cast<off_t>(valid_bytes)) != 0 ||
+        ::lseek(fd_, static_cast<off_t>(valid_bytes), SEEK_SET) < 0) {
+        *error = "truncate " + filename + ": " + strerror(errno);
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    if (valid_bytes == 0) {
+        if (!writeHeader(fd_)) {
+            *error = "write " + filename + ": " + strerror(errno);
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        valid_bytes = kWalHeaderSize;
+    }
+    ::fdatasync(fd_);
+    syncDirectory(filename);
+
+    appended_lsn_ = written_lsn_ = durable_lsn_ = valid_bytes;
+    stats_ = WalStats();
+    stats_.bytes = valid_bytes;
+    stats_.base_bytes = valid_bytes;
+    failed_ = false;
+    running_ = true;
+    flusher_ = std::thread([this]() { flushLoop(); });
+    return true;
+}
+
+void WriteAheadLog::close() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+        // 重写线程之后的调用看到 running_ 为 false 都会失败；等它手上的一次写入结束后删除新日志
+        durable_cv_.wait(lock, [this]() { return !rewrite_io_; });
+        abortRewriteLocked();
+    }
+    work_cv_.notify_one();
+    flusher_.join();
+    if (!failed_ && durable_lsn_ < written_lsn_ && ::fdatasync(fd_) == 0) {
+        durable_lsn_ = written_lsn_;
+    }
+    ::close(fd_);
+    fd_ = -1;
+    durable_cv_.notify_all();
+}
+
+uint64_t WriteAheadLog::appendSet(std::string_view key, std::string_view value, uint64_t expire_ms) {
+    return append(kWalSet, key, value, expire_ms);
+}
+
+uint64_t WriteAheadLog::appendDel(std::string_view key) {
+    return append(kWalDel, key, std::string_view(), 0);
+}
+
+size_t WriteAheadLog::encodeRecord(std::string* out, WalOp op, std::string_view key, std::string_view value,
+                                   uint64_t expire_ms) {
+    size_t start = out->size();
+    out->resize(start + kWalRecordHeaderSize);
+    out->push_back(static_cast<char>(op));
+    appendVarint(out, key.size());
+    appendVarint(out, value.size());
+    char expire[sizeof(uint64_t)];
+    store<uint64_t>(expire, expire_ms);
+    out->append(expire, sizeof(expire));
+    out->append(key.data(), key.size());
+    out->append(value.data(), value.size());
+    size_t payload_len = out->size() - start - kWalRecordHeaderSize;
+    char* header = &(*out)[start];
+    store<uint32_t>(header, static_cast<uint32_t>(payload_len));
+    store<uint32_t>(header + 4, crc32c::value(header + kWalRecordHeaderSize, payload_len));
+    return kWalRecordHeaderSize + payload_len;
+}
+
+uint64_t WriteAheadLog::append(WalOp op, std::string_view key, std::string_view value, uint64_t expire_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 磁盘跟不上时限制缓冲区大小，写入方在这里等待后台线程写出
+    durable_cv_.wait(lock, [this]() {
+        return pending_.size() < options_.max_pending_bytes || !running_ || failed_;
+    });
+    if (!running_) {
+        return 0;
+    }
+    size_t start = pending_.size();
+    size_t len = encodeRecord(&pending_, op, key, value, expire_ms);
+    if (rewriting_) {
+        // 重写开始之后的记录另存一份，重写完成时追加到新日志的末尾
+        rewrite_tail_.append(pending_, start, len);
+    }
+    appended_lsn_ += len;
+    ++stats_.records;
+    uint64_t lsn = appended_lsn_;
+    lock.unlock();
+    // 缓冲区原来不为空时后台线程一定会再检查一次，不用唤醒
+    if (start == 0) {
+        work_cv_.notify_one();
+    }
+    return lsn;
+}
+
+bool WriteAheadLog::waitDurable(uint64_t lsn) {
+    if (options_.fsync != kWalFsyncAlways) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    durable_cv_.wait(lock, [this, lsn]() { return durable_lsn_ >= lsn || failed_ || !running_; });
+    return durable_lsn_ >= lsn;
+}
+
+WalStats WriteAheadLog::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void WriteAheadLog::flushLoop() {
+    std::string batch;
+    auto interval = std::chrono::milliseconds(options_.interval_ms);
+    auto last_sync = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        auto ready = [this]() { return !pending_.empty() || !running_; };
+        if (options_.fsync == kWalFsyncInterval && written_lsn_ > durable_lsn_) {
+            work_cv_.wait_until(lock, last_sync + interval, ready);
+        } else {
+            work_cv_.wait(lock, ready);
+        }
+        if (pending_.empty() && !running_) {
+            break;
+        }
+        // 取走所有线程攒下的记录，锁外一次写出
+        batch.swap(pending_);
+        uint64_t lsn = appended_lsn_;
+        bool was_failed = failed_;
+        int fd = fd_;
+        flushing_ = true;
+        lock.unlock();
+
+        bool ok = !was_failed && (batch.empty() || writeAll(fd, batch.data(), batch.size()));
+        bool sync = false;
+        auto now = std::chrono::steady_clock::now();
+        if (ok && options_.fsync == kWalFsyncAlways) {
+            sync = !batch.empty();
+        } else if (ok && options_.fsync == kWalFsyncInterval) {
+            sync = now - last_sync >= interval;
+        }
+        if (sync) {
+            ok = ::fdatasync(fd) == 0;
+            last_sync = now;
+        }
+        size_t written = batch.size();
+        batch.clear();
+
+        lock.lock();
+        flushing_ = false;
+        if (ok) {
+            written_lsn_ = lsn;
+            stats_.bytes += written;
+            if (written > 0) {
+                ++stats_.writes;
+            }
+            if (sync) {
+                durable_lsn_ = lsn;
+                ++stats_.syncs;
+            }
+        } else {
+            // 写盘失败后不再写日志，通过 INFO 的 wal_status 报告
+            failed_ = true;
+            stats_.failed = true;
+        }
+        durable_cv_.notify_all();
+    }
+}
+
+bool WriteAheadLog::beginRewrite(std::string* error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || failed_ || rewrite_fd_ >= 0) {
+        *error = !running_ || failed_ ? "write-ahead log is not writable" : "rewrite already in progress";
+        return false;
+    }
+    rewrite_filename_ = filename_ + ".rewrite";
+    rewrite_fd_ = ::open(rewrite_filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (rewrite_fd_ < 0 || !writeHeader(rewrite_fd_)) {
+        *error = "create " + rewrite_filename_ + ": " + strerror(errno);
+        abortRewriteLocked();
+        return false;
+    }
+    rewrite_bytes_ = kWalHeaderSize;
+    rewrite_unsynced_ = kWalHeaderSize;
+    rewrite_written_ = 0;
+    rewrite_start_ = std::chrono::steady_clock::now();
+    stats_.rewrite_in_progress = true;
+    return true;
+}
+
+void WriteAheadLog::markRewritePoint() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rewriting_ = rewrite_fd_ >= 0;
+    rewrite_tail_.clear();
+}
+
+bool WriteAheadLog::appendRewrite(const char* data, size_t len) {
+    if (!startRewriteIo()) {
+        return false;
+    }
+    bool ok = writeRewrite(data, len);
+    endRewriteIo();
+    if (!ok) {
+        return false;
+    }
+    // 限速：写得比 rewrite_bytes_per_sec 快时睡眠，给前台请求的日志写入和落盘留出磁盘带宽
+    rewrite_written_ += len;
+    if (options_.rewrite_bytes_per_sec > 0) {
+        auto expected = std::chrono::duration<double>(static_cast<double>(rewrite_written_) /
+                                                      static_cast<double>(options_.rewrite_bytes_per_sec));
+        auto elapsed = std::chrono::steady_clock::now() - rewrite_start_;
+        if (expected > elapsed) {
+            std::this_thread::sleep_for(expected - elapsed);
+        }
+    }
+    return true;
+}
+
+// 写入新日志，每写 kRewriteSyncBytes 落盘一次，脏页不会一直积累到最后一次 fdatasync
+bool WriteAheadLog::writeRewrite(const char* data, size_t len) {
+    if (!writeAll(rewrite_fd_, data, len)) {
+        return false;
+    }
+    rewrite_bytes_ += len;
+    rewrite_unsynced_ += len;
+    return rewrite_unsynced_ < kRewriteSyncBytes || syncRewrite();
+}
+
+// 锁外使用 rewrite_fd_ 之前调用，日志已关闭或重写已放弃时返回 false
+bool WriteAheadLog::startRewriteIo() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || rewrite_fd_ < 0) {
+        return false;
+    }
+    rewrite_io_ = true;
+    return true;
+}
+
+void WriteAheadLog::endRewriteIo() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rewrite_io_ = false;
+    }
+    durable_cv_.notify_all();
+}
+
+bool WriteAheadLog::syncRewrite() {
+    if (::fdatasync(rewrite_fd_) != 0) {
+        return false;
+    }
+    rewrite_unsynced_ = 0;
+    return true;
+}
+
+bool WriteAheadLog::finishRewrite(std::string* error) {
+    std::string tail;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_ || rewrite_fd_ < 0) {
+        *error = "write-ahead log is not writable";
+        abortRewriteLocked();
+        return false;
+    }
+    // 先在锁外追赶重写期间积累的记录，剩下的不多时在锁外 fdatasync 一次；之后锁内只需要写完、
+    // 落盘这次 fdatasync 期间新追加的一小段，缩短阻塞写入方的时间。锁外期间 close 可能已放弃重写
+    while (rewrite_tail_.size() > kRewriteTailInLock) {
+        tail.swap(rewrite_tail_);
+        rewrite_io_ = true;
+        lock.unlock();
+        bool ok = writeRewrite(tail.data(), tail.size());
+        tail.clear();
+        lock.lock();
+        rewrite_io_ = false;
+        durable_cv_.notify_all();
+        if (!running_) {
+            *error = "write-ahead log is not writable";
+            abortRewriteLocked();
+            return false;
+        }
+        if (!ok) {
+            *error = "write " + rewrite_filename_ + ": " + strerror(errno);
+            abortRewriteLocked();
+            return false;
+        }
+    }
+    rewrite_io_ = true;
+    lock.unlock();
+    bool synced = syncRewrite();
+    lock.lock();
+    rewrite_io_ = false;
+    durable_cv_.notify_all();
+    if (!running_) {
+        *error = "write-ahead log is not writable";
+        abortRewriteLocked();
+        return false;
+    }
+    if (!synced) {
+        *error = "sync " + rewrite_filename_ + ": " + strerror(errno);
+        abortRewriteLocked();
+        return false;
+    }
+    // 等后台线程写完手上的一批，之后它拿不到锁，旧日志不会再被写入
+    durable_cv_.wait(lock, [this]() { return !flushing_; });
+    if (!running_ || failed_) {
+        *error = "write-ahead log is not writable";
+        abortRewriteLocked();
+        return false;
+    }
+    if (!writeAll(rewrite_fd_, rewrite_tail_.data(), rewrite_tail_.size()) || ::fdatasync(rewrite_fd_) != 0 ||
+        ::rename(rewrite_filename_.c_str(), filename_.c_str()) != 0) {
+        *error = "finish " + rewrite_filename_ + ": " + strerror(errno);
+        abortRewriteLocked();
+        return false;
+    }
+    rewrite_bytes_ += rewrite_tail_.size();
+    syncDirectory(filename_);
+    // 新日志已包含重写时刻的全部数据和之后的所有记录，还没写进旧日志的 pending_ 也都在其中
+    int old_fd = fd_;
+    fd_ = rewrite_fd_;
+    rewrite_fd_ = -1;
+    rewriting_ = false;
+    std::string().swap(rewrite_tail_);
+    pending_.clear();
+    written_lsn_ = durable_lsn_ = appended_lsn_;
+    stats_.bytes = stats_.base_bytes = rewrite_bytes_;
+    stats_.rewrite_in_progress = false;
+    ++stats_.rewrites;
+    stats_.last_rewrite_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - rewrite_start_).count());
+    lock.unlock();
+    durable_cv_.notify_all();
+    // 旧日志已经被 rename 替换，关闭最后一个引用时文件系统要释放整个文件，放在锁外
+    ::close(old_fd);
+    return true;
+}
+
+void WriteAheadLog::abortRewrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    abortRewriteLocked();
+}
+
+void WriteAheadLog::abortRewriteLocked() {
+    if (rewrite_fd_ >= 0) {
+        ::close(rewrite_fd_);
+        rewrite_fd_ = -1;
+        ::unlink(rewrite_filename_.c_str());
+    }
+    rewriting_ = false;
+    std::string().swap(rewrite_tail_);
+    if (stats_.rewrite_in_progress) {
+        stats_.rewrite_in_progress = false;
+        ++stats_.rewrite_failures;
+    }
+}
@@ -0,0 +1,162 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// 追加写的变更日志（write-ahead log），记录 set / del，启动时在快照之后回放。
+// 文件格式，整数均为小端：
+//
+//   文件头 | magic "KVSWAL\0\0" (8) | version (4) | flags (4) |
+//   记录   | payload_len (4) | crc (4) | payload |   × N
+//
+//   payload：op (1) | key_len (varint) | value_len (varint) | expire_ms (8) | key | value
+//   crc 为 payload 的 CRC32C；expire_ms 是墙上时间毫秒，kWalNoExpire 表示不过期，del 记录为 0。
+//   崩溃时最后一条记录可能只写了一半，回放在第一条不完整或校验失败的记录处停止，打开时截掉之后的部分。
+//
+// 写入方在分片锁内把记录追加到内存缓冲区（保证同一个键的日志顺序与执行顺序一致），由后台线程
+// 把所有工作线程攒下的记录一次 write 出去（组提交）。fsync 策略：
+//   always   每批 write 后 fdatasync，append 的调用方在 waitDurable 中等到所在批次落盘再返回，
+//            并发的请求共享一次 fdatasync；
+//   interval 每隔 interval_ms 毫秒 fdatasync 一次，崩溃最多丢失这段时间内的写入；
+//   os       只 write，由操作系统决定何时落盘。
+//
+// 日志重写（压缩）：反复覆盖的热点键会让日志无限增长。重写在后台从存储的一致快照生成只含每个键
+// 当前值的新日志 <filename>.rewrite（限速写出，每 8MB 落盘一次），快照时刻之后追加的记录同时另存在内存里，
+// 快照写完后在锁外追加这部分并落盘，只把落盘期间新追加的一小段留到锁内写完、fdatasync，然后 rename
+// 原子替换旧日志；
+// 任何一步失败都保留旧日志。
+
+const uint32_t kWalVersion = 1;
+const uint64_t kWalNoExpire = UINT64_MAX;
+const size_t kWalHeaderSize = 16;
+const size_t kWalRecordHeaderSize = 8;
+
+enum WalOp : uint8_t {
+    kWalSet = 1,
+    kWalDel = 2,
+};
+
+enum WalFsyncPolicy {
+    kWalFsyncAlways,
+    kWalFsyncInterval,
+    kWalFsyncOs,
+};
+
+struct WalOptions {
+    WalFsyncPolicy fsync = kWalFsyncInterval;
+    int interval_ms = 1000;                      // interval 策略的 fdatasync 周期
+    size_t max_pending_bytes = 64 << 20;         // 待写出的记录超过该大小时 append 等待，防止磁盘跟不上时内存无限增长
+    size_t rewrite_bytes_per_sec = 32 << 20;     // 重写写盘的限速，0 表示不限速
+};
+
+// 一条回放出的记录，key / value 指向读缓冲区
+struct WalRecord {
+    WalOp op = kWalSet;
+    std::string_view key;
+    std::string_view value;
+    uint64_t expire_ms = kWalNoExpire;
+};
+
+struct WalStats {
+    uint64_t records = 0;   // 追加的记录数
+    uint64_t bytes = 0;     // 日志文件字节数
+    uint64_t writes = 0;    // write 批次数，records / writes 即组提交的平均批量
+    uint64_t syncs = 0;     // fdatasync 次数
+    bool failed = false;    // 写盘或 fdatasync 失败后停止记录
+    uint64_t base_bytes = 0;         // 打开或上次重写完成时的日志大小，自动重写按增长比例触发
+    bool rewrite_in_progress = false;
+    uint64_t rewrites = 0;           // 完成的重写次数
+    uint64_t rewrite_failures = 0;
+    uint64_t last_rewrite_ms = 0;    // 最近一次重写的耗时
+};
+
+class WriteAheadLog {
+public:
+    WriteAheadLog() = default;
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // 依次回放日志中的有效记录，valid_bytes 返回有效部分的长度（文件不存在时为 0）；
+    // 文件头非法时返回 false
+    static bool replay(const std::string& filename, const std::function<void(const WalRecord&)>& fn,
+                       uint64_t* valid_bytes, uint64_t* records, std::string* error);
+
+    // 打开日志准备追加：截掉 valid_bytes 之后不完整的尾部，新文件写入文件头，启动后台写线程
+    bool open(const std::string& filename, uint64_t valid_bytes, const WalOptions& options, std::string* error);
+    // 写出所有记录、落盘并停止后台线程；进行中的重写被放弃，之后的重写调用都返回失败
+    void close();
+
+    // 追加一条记录，返回记录的 LSN，调用方持有被修改键所在分片的锁
+    uint64_t appendSet(std::string_view key, std::string_view value, uint64_t expire_ms);
+    uint64_t appendDel(std::string_view key);
+    // always 策略下等待 lsn 之前的记录落盘（不要持有分片锁），其他策略直接返回；落盘失败返回 false
+    bool waitDurable(uint64_t lsn);
+
+    WalStats stats();
+
+    // 日志重写，由一个后台线程依次调用（见 KVStore::rewriteLog）：
+    // beginRewrite 创建新日志文件；markRewritePoint 在快照时刻调用（持有所有分片的锁），之后追加的
+    // 记录另存一份；appendRewrite 限速写入快照中的记录；finishRewrite 追加另存的记录并替换旧日志。
+    // 失败时调用 abortRewrite 删除新文件，旧日志不受影响
+    bool beginRewrite(std::string* error);
+    void markRewritePoint();
+    bool appendRewrite(const char* data, size_t len);
+    bool finishRewrite(std::string* error);
+    void abortRewrite();
+
+    // 把一条记录编码追加到 out，返回编码后的字节数
+    static size_t encodeRecord(std::string* out, WalOp op, std::string_view key, std::string_view value,
+                               uint64_t expire_ms);
+
+private:
+    static const size_t kRewriteTailInLock = 1 << 20;  // 另存的记录少于该大小时在锁内写完
+    static const size_t kRewriteSyncBytes = 8 << 20;   // 重写时每写这么多字节落盘一次
+
+    uint64_t append(WalOp op, std::string_view key, std::string_view value, uint64_t expire_ms);
+    void flushLoop();
+    void abortRewriteLocked();
+    bool startRewriteIo();
+    void endRewriteIo();
+    bool writeRewrite(const char* data, size_t len);
+    bool syncRewrite();
+
+    std::string filename_;
+    WalOptions options_;
+    int fd_ = -1;
+    std::thread flusher_;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;     // 有新记录或需要停止时唤醒后台线程
+    std::condition_variable durable_cv_;  // 一批记录写出（always 策略下为落盘）后唤醒等待者
+    std::string pending_;                 // 还没写出的记录
+    // LSN 是追加的累计字节数，与文件偏移无关，重写替换文件后继续递增
+    uint64_t appended_lsn_ = 0;           // 已追加到 pending_ 的位置
+    uint64_t written_lsn_ = 0;            // 已 write 的位置
+    uint64_t durable_lsn_ = 0;            // 已 fdatasync 的位置
+    bool running_ = false;
+    bool failed_ = false;
+    bool flushing_ = false;               // 后台线程正在锁外写一批记录
+    WalStats stats_;
+
+    std::string rewrite_filename_;
+    int rewrite_fd_ = -1;
+    bool rewriting_ = false;              // 已过快照时刻，新记录同时追加到 rewrite_tail_
+    bool rewrite_io_ = false;             // 重写线程正在锁外写入或落盘 rewrite_fd_，close 等它结束
+    std::string rewrite_tail_;
+    uint64_t rewrite_bytes_ = 0;          // 新日志的大小
+    uint64_t rewrite_unsynced_ = 0;       // 新日志中还没 fdatasync 的字节数
+    uint64_t rewrite_written_ = 0;        // 限速统计的已写字节数
+    std::chrono::steady_clock::time_point rewrite_start_;
+};
+
+#endif
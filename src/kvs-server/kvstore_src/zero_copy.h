@@ -0,0 +1,178 @@
+#ifndef ZERO_COPY_H
+#define ZERO_COPY_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "kvstore.h"
+#include "muduo/net/Buffer.h"
+
+// 输出缓冲区中的大值引用。GET 命中共享存储的大值时不把值拷进输出缓冲区，而是在当前位置
+// 记录一个引用（持有 SharedValue），输出变成"缓冲区片段、值、缓冲区片段……"组成的链，
+// 任意大小的值都不需要一份连续的拷贝。发送时用聚集写（sendmsg / IORING_OP_SENDMSG）一次发出
+// 链上的多段，超过零拷贝阈值的值用 MSG_ZEROCOPY / IORING_OP_SEND_ZC 单独发送；
+// 发送期间覆盖或删除键不影响已发出的引用。
+struct ValueRef {
+    size_t offset = 0;  // 值插在输出缓冲区当前可读数据的第 offset 个字节之前
+    SharedValue value;
+    size_t sent = 0;    // 已发送的字节数
+};
+
+// 先进先出队列，元素放在 vector 中从 head_ 开始。默认构造和清空后都不占堆内存
+// （libstdc++ 的 std::deque 默认构造就要分配约 600 字节），适合作为每个连接都有、但多数时候为空的成员
+template <typename T>
+class FifoQueue {
+public:
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    bool empty() const { return head_ == items_.size(); }
+    size_t size() const { return items_.size() - head_; }
+    T& front() { return items_[head_]; }
+    const T& front() const { return items_[head_]; }
+    T& back() { return items_.back(); }
+    T& operator[](size_t i) { return items_[head_ + i]; }
+    const T& operator[](size_t i) const { return items_[head_ + i]; }
+    iterator begin() { return items_.begin() + static_cast<std::ptrdiff_t>(head_); }
+    iterator end() { return items_.end(); }
+    const_iterator begin() const { return items_.begin() + static_cast<std::ptrdiff_t>(head_); }
+    const_iterator end() const { return items_.end(); }
+
+    void push_back(T&& item) { items_.push_back(std::move(item)); }
+    template <typename... Args>
+    void emplace_back(Args&&... args) { items_.emplace_back(std::forward<Args>(args)...); }
+
+    // 出队的元素立即析构（释放其持有的值）；队列空了释放内存，已出队的部分过半时前移剩余元素
+    void pop_front() {
+        items_[head_] = T();
+        if (++head_ == items_.size()) {
+            clear();
+        } else if (head_ >= 32 && head_ * 2 >= items_.size()) {
+            items_.erase(items_.begin(), begin());
+            head_ = 0;
+        }
+    }
+    iterator erase(iterator it) {
+        it = items_.erase(it);
+        if (empty()) {
+            clear();
+            return end();
+        }
+        return it;
+    }
+    void clear() {
+        std::vector<T>().swap(items_);
+        head_ = 0;
+    }
+
+private:
+    std::vector<T> items_;
+    size_t head_ = 0;
+};
+
+// 一个输出缓冲区对应的大值引用表，按 offset 递增排列；offset 相对缓冲区的读位置，
+// 发送缓冲区中的字节后由 consumeBuffered 同步减小
+struct ZeroCopyRefs {
+    FifoQueue<ValueRef> refs;
+
+    bool empty() const { return refs.empty(); }
+    void clear() { refs.clear(); }
+
+    // 缓冲区中排在第一个值之前、可以直接发送的字节数
+    size_t bufferedBefore(size_t readable) const { return refs.empty() ? readable : refs.front().offset; }
+    // 下一段要发送的是值本身
+    bool atValue() const { return !refs.empty() && refs.front().offset == 0; }
+    // 队首值中还没发送的部分
+    std::string_view frontValue() const {
+        const ValueRef& ref = refs.front();
+        return std::string_view(*ref.value).substr(ref.sent);
+    }
+    const SharedValue& frontOwner() const { return refs.front().value; }
+
+    // 从缓冲区发送了 n 字节（n 不超过 bufferedBefore）
+    void consumeBuffered(size_t n) {
+        for (ValueRef& ref : refs) {
+            ref.offset -= n;
+        }
+    }
+
+    // 队首值发送了 n 字节，发完后出队
+    void consumeValue(size_t n) {
+        ValueRef& ref = refs.front();
+        ref.sent += n;
+        if (ref.sent == ref.value->size()) {
+            refs.pop_front();
+        }
+    }
+
+    // 发送了 n 字节，可以跨越多个缓冲区片段和值
+    void consume(muduo::net::Buffer* output, size_t n) {
+        while (n > 0) {
+            if (atValue()) {
+                size_t len = std::min(n, frontValue().size());
+                consumeValue(len);
+                n -= len;
+            } else {
+                size_t len = std::min(n, bufferedBefore(output->readableBytes()));
+                output->retrieve(len);
+                consumeBuffered(len);
+                n -= len;
+            }
+        }
+    }
+
+    // 按发送顺序把输出链填进 iov，最多 max 段，返回段数；
+    // 遇到不小于 stop 字节的值时停在它之前（留给零拷贝发送），stop 为 0 表示不停
+    size_t gather(const muduo::net::Buffer& output, iovec* iov, size_t max, size_t stop) const {
+        const char* base = output.peek();
+        size_t readable = output.readableBytes();
+        size_t count = 0;
+        size_t pos = 0;
+        for (size_t i = 0; count < max;) {
+            size_t end = i < refs.size() ? refs[i].offset : readable;
+            if (end > pos) {
+                iov[count].iov_base = const_cast<char*>(base + pos);
+                iov[count].iov_len = end - pos;
+                ++count;
+                pos = end;
+                continue;
+            }
+            if (i == refs.size() || (stop > 0 && refs[i].value->size() >= stop)) {
+                break;
+            }
+            std::string_view value = std::string_view(*refs[i].value).substr(refs[i].sent);
+            iov[count].iov_base = const_cast<char*>(value.data());
+            iov[count].iov_len = value.size();
+            ++count;
+            ++i;
+        }
+        return count;
+    }
+
+    // 另一个缓冲区的内容追加到本缓冲区的 base 字节处时，把它的引用一起移过来
+    void splice(ZeroCopyRefs* other, size_t base) {
+        for (ValueRef& ref : other->refs) {
+            ref.offset += base;
+            refs.push_back(std::move(ref));
+        }
+        other->refs.clear();
+    }
+};
+
+// 把值追加到输出：有引用表且值在共享存储中时只记录引用，否则拷贝
+inline void appendValue(muduo::net::Buffer* output, std::string_view value, const SharedValue& owner,
+                        ZeroCopyRefs* zc) {
+    if (zc != nullptr && owner && !value.empty()) {
+        ValueRef ref;
+        ref.offset = output->readableBytes();
+        ref.value = owner;
+        zc->refs.push_back(std::move(ref));
+    } else {
+        output->append(value.data(), value.size());
+    }
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <signal.h>
+#include <sys/stat.h>
+#include <string.h>
 #include <thread>
 
 #include "muduo/net/TcpServer.h"
@@ -16,19 +18,58 @@ using namespace muduo;
 using namespace muduo::net;
 using namespace std;
 
-#define reactor 1
-#define proactor 0
+// 定时持久化任务：快照在后台线程中写出，不阻塞请求处理
+void startPeriodicPersistence(std::chrono::seconds interval, const std::string& filename,
+                              const SnapshotOptions& options) {
+    std::thread([interval, filename, options]() {
+        while (true) {
+            std::this_thread::sleep_for(interval);
+            std::string error;
+            if (!KVStore::getInstance().persistToFile(filename, options, &error)) {
+                LOG_ERROR << "snapshot " << filename << " failed: " << error;
+                continue;
+            }
+            SnapshotStats stats = KVStore::getInstance().snapshotStats();
+            LOG_INFO << "snapshot " << filename << ": " << stats.last_keys << " keys, " << stats.last_bytes
+                     << " bytes in " << stats.last_duration_ms << " ms, " << stats.last_cow_entries << " cow entries";
+        }
+    }).detach();
+}
 
-// 定时持久化任务
-void startPeriodicPersistence(std::chrono::seconds interval, const std::string& filename) {
-    std::thread([interval, filename]() {
+// 定时检查变更日志：不小于 min_bytes 且比上次重写后增长了 percent% 时在后台重写
+// （与 Redis 的 auto-aof-rewrite-min-size / auto-aof-rewrite-percentage 相同）
+void startLogRewriter(std::chrono::milliseconds interval, uint64_t min_bytes, uint64_t percent) {
+    std::thread([interval, min_bytes, percent]() {
         while (true) {
             std::this_thread::sleep_for(interval);
-            KVStore::getInstance().persistToFile(filename);
+            WalStats stats = KVStore::getInstance().walStats();
+            if (stats.failed || stats.bytes < min_bytes || stats.bytes * 100 < stats.base_bytes * (100 + percent)) {
+                continue;
+            }
+            std::string error;
+            if (!KVStore::getInstance().rewriteLog(&error)) {
+                LOG_ERROR << "write-ahead log rewrite failed: " << error;
+                continue;
+            }
+            WalStats after = KVStore::getInstance().walStats();
+            LOG_INFO << "write-ahead log rewritten: " << stats.bytes << " -> " << after.bytes << " bytes in "
+                     << after.last_rewrite_ms << " ms";
         }
     }).detach();
 }
 
+// 解析内存大小配置，支持 b/kb/mb/gb 后缀（不区分大小写），如 256mb
+static size_t parseMemorySize(const char *str) {
+    char *end = NULL;
+    unsigned long long value = strtoull(str, &end, 10);
+    std::string unit(end);
+    for (auto &c : unit) c = tolower(c);
+    if (unit == "kb" || unit == "k") value <<= 10;
+    else if (unit == "mb" || unit == "m") value <<= 20;
+    else if (unit == "gb" || unit == "g") value <<= 30;
+    return static_cast<size_t>(value);
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -59,24 +100,171 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    // 设置 KV 存储的最大容量
-    KVStore::getInstance().setMaxCapacity(200);
-    // 启动定时清理过期 key 的任务
-    KVStore::getInstance().startExpirationCleaner(std::chrono::minutes(1));
-    // 从文件加载持久化数据
-    // std::thread([](){
-    //     LOG_INFO << "Starting async data loading...";
-    //     KVStore::getInstance().loadFromFile("kv_store_data.txt");
-    //     LOG_INFO << "Data loading completed";
-    // }).detach();
+    // 设置 KV 存储的分片数量，必须在设置容量和处理请求之前完成
+    char *str_shard_count = config_file.GetConfigName("shard_count");
+    if (str_shard_count) {
+        KVStore::getInstance().setShardCount(atoi(str_shard_count));
+    }
+    // 设置淘汰策略（clock / sampled_lru / wtinylfu）
+    char *str_eviction_policy = config_file.GetConfigName("eviction_policy");
+    if (str_eviction_policy) {
+        char *str_eviction_samples = config_file.GetConfigName("eviction_samples");
+        size_t samples = str_eviction_samples ? atoi(str_eviction_samples) : 5;
+        if (!KVStore::getInstance().setEvictionPolicy(str_eviction_policy, samples)) {
+            LOG_ERROR << "unknown eviction_policy: " << str_eviction_policy << ", use clock";
+        }
+    }
+    // 设置 KV 存储的最大容量（键数，0 表示不限制）
+    char *str_max_capacity = config_file.GetConfigName("max_capacity");
+    KVStore::getInstance().setMaxCapacity(str_max_capacity ? atoi(str_max_capacity) : 200);
+    // 设置 KV 存储的最大内存，超出后按淘汰策略淘汰
+    char *str_maxmemory = config_file.GetConfigName("maxmemory");
+    if (str_maxmemory) {
+        KVStore::getInstance().setMaxMemory(parseMemorySize(str_maxmemory));
+    }
+    // 启动后台渐进式扩容任务，每 1ms 每个分片最多迁移 64 个组
+    KVStore::getInstance().startRehashWorker(std::chrono::milliseconds(1), 64);
+    // 设置过期时间轮的 tick 精度（毫秒）和每个 tick 每个分片最多清理的过期 key 数
+    char *str_expire_tick_ms = config_file.GetConfigName("expire_tick_ms");
+    int expire_tick_ms = str_expire_tick_ms ? atoi(str_expire_tick_ms) : 100;
+    if (expire_tick_ms <= 0) expire_tick_ms = 100;
+    char *str_expire_keys_per_tick = config_file.GetConfigName("expire_keys_per_tick");
+    size_t expire_keys_per_tick = str_expire_keys_per_tick ? atoi(str_expire_keys_per_tick) : 1000;
+    KVStore::getInstance().setExpireTick(std::chrono::milliseconds(expire_tick_ms));
+    // 启动定时清理过期 key 的任务：wheel 按时间轮精确清理，adaptive 按 Redis 风格随机采样
+    char *str_expire_mode = config_file.GetConfigName("expire_mode");
+    if (str_expire_mode && strcmp(str_expire_mode, "adaptive") == 0) {
+        char *str_budget = config_file.GetConfigName("expire_cycle_budget_us");
+        char *str_samples = config_file.GetConfigName("expire_cycle_samples");
+        char *str_ratio = config_file.GetConfigName("expire_cycle_ratio");
+        KVStore::getInstance().startAdaptiveExpireCycle(
+            std::chrono::milliseconds(expire_tick_ms),
+            std::chrono::microseconds(str_budget ? atoi(str_budget) : 1000),
+            str_samples ? atoi(str_samples) : 20,
+            str_ratio ? atoi(str_ratio) : 10);
+    } else {
+        KVStore::getInstance().startExpirationCleaner(std::chrono::milliseconds(expire_tick_ms), expire_keys_per_tick);
+    }
+    // 不小于 stream_value_threshold 的值按共享存储保存，proactor / reactor 的响应只引用不拷贝，
+    // 聚集发送；不小于 zerocopy_threshold 的值直接从存储零拷贝发送；0 表示关闭
+    char *str_stream_threshold = config_file.GetConfigName("stream_value_threshold");
+    size_t stream_threshold = str_stream_threshold ? parseMemorySize(str_stream_threshold) : 0;
+    char *str_zerocopy_threshold = config_file.GetConfigName("zerocopy_threshold");
+    size_t zerocopy_threshold = str_zerocopy_threshold ? parseMemorySize(str_zerocopy_threshold) : 0;
+    size_t shared_threshold = stream_threshold;
+    if (zerocopy_threshold > 0 && (shared_threshold == 0 || zerocopy_threshold < shared_threshold)) {
+        shared_threshold = zerocopy_threshold;
+    }
+    KVStore::getInstance().setSharedValueThreshold(shared_threshold);
+    // 快照文件、块大小和块压缩算法（none / zlib）
+    char *str_snapshot_file = config_file.GetConfigName("snapshot_file");
+    std::string snapshot_file = str_snapshot_file ? str_snapshot_file : "kv_store_data.snap";
+    SnapshotOptions snapshot_options;
+    char *str_snapshot_block_size = config_file.GetConfigName("snapshot_block_size");
+    if (str_snapshot_block_size) snapshot_options.block_size = parseMemorySize(str_snapshot_block_size);
+    char *str_snapshot_compression = config_file.GetConfigName("snapshot_compression");
+    if (str_snapshot_compression && strcmp(str_snapshot_compression, "zlib") == 0) {
+        snapshot_options.codec = kSnapshotCodecZlib;
+    } else if (str_snapshot_compression && strcmp(str_snapshot_compression, "none") != 0) {
+        LOG_ERROR << "unknown snapshot_compression: " << str_snapshot_compression << ", use none";
+    }
+    // 启动时加载数据：变更日志存在时它已经包含全部数据（快照之后删除的键只在日志里有记录），只回放日志；
+    // 否则按 snapshot_load_threads 个线程（0 表示按 CPU 核数）并行加载快照，加载完成后才开始服务
+    char *str_wal_file = config_file.GetConfigName("wal_file");
+    bool wal_enabled = str_wal_file && str_wal_file[0] != '\0';
+    // 只有文件头的日志是加载快照后还没重写完就退出留下的，仍然需要加载快照
+    struct stat st;
+    bool wal_exists = wal_enabled && stat(str_wal_file, &st) == 0 && static_cast<size_t>(st.st_size) > kWalHeaderSize;
+    LoadStats load_stats;
+    if (!wal_exists && stat(snapshot_file.c_str(), &st) == 0) {
+        char *str_load_threads = config_file.GetConfigName("snapshot_load_threads");
+        size_t load_threads = str_load_threads ? atoi(str_load_threads) : 0;
+        std::string error;
+        if (KVStore::getInstance().loadFromFile(snapshot_file, &error, &load_stats, load_threads)) {
+            LOG_INFO << "loaded " << load_stats.keys << " keys (" << load_stats.bytes / (1024 * 1024) << " MB) from "
+                     << snapshot_file << " with " << load_stats.threads << " threads in " << load_stats.elapsed_ms
+                     << " ms, " << load_stats.keys * 1000 / std::max<uint64_t>(1, load_stats.elapsed_ms) << " keys/s";
+        } else {
+            LOG_ERROR << "load snapshot " << snapshot_file << " failed: " << error << ", " << load_stats.keys
+                      << " keys loaded";
+        }
+    }
+    // 变更日志：回放上次退出前的 set / del，之后的写入按 wal_fsync 策略组提交落盘；不配置 wal_file 表示关闭
+    if (wal_enabled) {
+        WalOptions wal_options;
+        char *str_wal_fsync = config_file.GetConfigName("wal_fsync");
+        if (str_wal_fsync && strcmp(str_wal_fsync, "always") == 0) {
+            wal_options.fsync = kWalFsyncAlways;
+        } else if (str_wal_fsync && strcmp(str_wal_fsync, "os") == 0) {
+            wal_options.fsync = kWalFsyncOs;
+        } else if (str_wal_fsync && strcmp(str_wal_fsync, "interval") != 0) {
+            LOG_ERROR << "unknown wal_fsync: " << str_wal_fsync << ", use interval";
+        }
+        char *str_wal_interval = config_file.GetConfigName("wal_fsync_interval_ms");
+        if (str_wal_interval) wal_options.interval_ms = atoi(str_wal_interval);
+        char *str_rewrite_rate = config_file.GetConfigName("wal_rewrite_bytes_per_sec");
+        if (str_rewrite_rate) wal_options.rewrite_bytes_per_sec = parseMemorySize(str_rewrite_rate);
+        uint64_t replayed = 0;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        if (!KVStore::getInstance().openWriteAheadLog(str_wal_file, wal_options, &replayed, &error)) {
+            LOG_ERROR << "open write-ahead log failed: " << error;
+            return -1;
+        }
+        LOG_INFO << "replayed " << replayed << " log records from " << str_wal_file << " in "
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                 << " ms";
+        // 新建的日志里还没有从快照加载的数据，立即重写一次，之后只回放日志也不会丢失这些键
+        if (load_stats.keys > 0 && !KVStore::getInstance().rewriteLog(&error)) {
+            LOG_ERROR << "rewrite write-ahead log after loading snapshot failed: " << error;
+            return -1;
+        }
+        char *str_rewrite_min = config_file.GetConfigName("wal_rewrite_min_size");
+        char *str_rewrite_percent = config_file.GetConfigName("wal_rewrite_percentage");
+        uint64_t rewrite_percent = str_rewrite_percent ? atoi(str_rewrite_percent) : 100;
+        if (rewrite_percent > 0) {
+            startLogRewriter(std::chrono::seconds(1), str_rewrite_min ? parseMemorySize(str_rewrite_min) : 64 << 20,
+                             rewrite_percent);
+        }
+    }
     // 启动定时持久化任务
-    startPeriodicPersistence(std::chrono::seconds(60), "kv_store_data.txt");
-
-    std::cout << "run server" << std::endl;
+    startPeriodicPersistence(std::chrono::seconds(60), snapshot_file, snapshot_options);
 
-    #if reactor
-    runReactorServer();
-    #elif proactor
-    runProactorServer();
-    #endif
+    // 选择服务器模型：reactor（单 epoll + 线程池） / proactor（io_uring） / multi_reactor（每核一个 loop）
+    char *str_server_mode = config_file.GetConfigName("server_mode");
+    std::string server_mode = str_server_mode ? str_server_mode : "reactor";
+    std::cout << "run server: " << server_mode << std::endl;
+    if (server_mode == "multi_reactor") {
+        char *str_io_loops = config_file.GetConfigName("io_loops");
+        runMultiReactorServer(str_io_loops ? atoi(str_io_loops) : 0);
+    } else if (server_mode == "proactor") {
+        ProactorOptions options;
+        char *str_multishot = config_file.GetConfigName("proactor_multishot");
+        if (str_multishot) options.multishot = atoi(str_multishot) != 0;
+        char *str_buf_count = config_file.GetConfigName("proactor_buf_count");
+        if (str_buf_count) options.buf_ring_entries = atoi(str_buf_count);
+        char *str_buf_size = config_file.GetConfigName("proactor_buf_size");
+        if (str_buf_size) options.buf_size = atoi(str_buf_size);
+        char *str_rings = config_file.GetConfigName("proactor_rings");
+        if (str_rings) options.rings = atoi(str_rings);
+        char *str_pin_cpu = config_file.GetConfigName("proactor_pin_cpu");
+        if (str_pin_cpu) options.pin_cpu = atoi(str_pin_cpu) != 0;
+        char *str_fixed_files = config_file.GetConfigName("proactor_fixed_files");
+        if (str_fixed_files) options.fixed_files = atoi(str_fixed_files);
+        char *str_fixed_buf_count = config_file.GetConfigName("proactor_fixed_buf_count");
+        if (str_fixed_buf_count) options.fixed_buf_count = atoi(str_fixed_buf_count);
+        char *str_fixed_buf_size = config_file.GetConfigName("proactor_fixed_buf_size");
+        if (str_fixed_buf_size) options.fixed_buf_size = atoi(str_fixed_buf_size);
+        char *str_sqpoll = config_file.GetConfigName("proactor_sqpoll");
+        if (str_sqpoll) options.sqpoll = atoi(str_sqpoll) != 0;
+        char *str_sqpoll_idle = config_file.GetConfigName("proactor_sqpoll_idle_ms");
+        if (str_sqpoll_idle) options.sqpoll_idle_ms = atoi(str_sqpoll_idle);
+        options.zerocopy_threshold = zerocopy_threshold;
+        runProactorServer(options);
+    } else {
+        if (server_mode != "reactor") {
+            LOG_ERROR << "unknown server_mode: " << server_mode << ", use reactor";
+        }
+        runReactorServer(zerocopy_threshold);
+    }
 }
\ No newline at end of file